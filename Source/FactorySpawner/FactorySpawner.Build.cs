@@ -75,6 +75,7 @@ public class FactorySpawner : ModuleRules
 		
 		PrivateDependencyModuleNames.AddRange(new string[] {
 			// ... add private dependencies that you statically link with here ...	
+			"Projects"
 		});
 		
 		DynamicallyLoadedModuleNames.AddRange(new string[] {
@@ -0,0 +1,225 @@
+#include "BuildPlan.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    constexpr uint32 PlanFileMagic = 0x4C505346; // "FSPL"
+    constexpr uint32 PlanFileVersion = 2; // 2: class of custom machines
+
+    struct FPlanFileHeader
+    {
+        uint32 Magic = PlanFileMagic;
+        uint32 Version = PlanFileVersion;
+        uint32 BuildableLayout = 0;
+        int32 NumBuildables = 0;
+        int32 NumConnections = 0;
+        int32 NumClassPaths = 0;
+        uint32 BuildablesOffset = 0;
+        uint32 ConnectionsOffset = 0;
+        uint32 ClassPathsOffset = 0; // Class paths as int32 length + UTF-8 characters
+        uint32 Reserved = 0;
+    };
+
+    // Records store EBuildable values, so a plan is only valid as long as the enum keeps its order
+    uint32 GetBuildableLayout()
+    {
+        static const uint32 Layout = []
+        {
+            const UEnum* Enum = StaticEnum<EBuildable>();
+            uint32 Crc = 0;
+            for (int32 i = 0; i < Enum->NumEnums(); ++i)
+                Crc = FCrc::StrCrc32(*Enum->GetNameStringByIndex(i), Crc);
+            return Crc;
+        }();
+        return Layout;
+    }
+} // namespace
+
+FBuildPlan::FBuildPlan(const FBuildPlanView& View)
+{
+    Buildables.Append(View.Buildables.GetData(), View.Buildables.Num());
+    Connections.Append(View.Connections.GetData(), View.Connections.Num());
+    ClassPaths.Append(View.ClassPaths.GetData(), View.ClassPaths.Num());
+}
+
+int32 FBuildPlan::AddBuildable(EBuildable Type, const FVector& Location, bool bFlipped, int32 Row)
+{
+    FPlannedBuildable& Buildable = Buildables.AddDefaulted_GetRef();
+    Buildable.Type = Type;
+    Buildable.Location = FVector3f(Location);
+    Buildable.bFlipped = bFlipped;
+    Buildable.Row = Row;
+    return Buildables.Num() - 1;
+}
+
+void FBuildPlan::Connect(EPlannedLink Type, const FPlanPort& From, const FPlanPort& To, int32 Tier)
+{
+    Connections.Add({From.Buildable, To.Buildable, (uint8) From.Port, (uint8) To.Port, Type, (uint8) Tier});
+}
+
+int32 FBuildPlan::AddClassPath(const FString& ClassPath)
+{
+    return ClassPaths.AddUnique(ClassPath);
+}
+
+void FBuildPlan::Reserve(int32 NumBuildables, int32 NumConnections)
+{
+    Buildables.Reserve(NumBuildables);
+    Connections.Reserve(NumConnections);
+}
+
+void FBuildPlan::Reset()
+{
+    Buildables.Reset();
+    Connections.Reset();
+    ClassPaths.Reset();
+}
+
+FString FBuildPlan::GetSavePath(const FString& Name)
+{
+    if (Name.IsEmpty() || Name.Contains(TEXT("..")) || !FPaths::IsRelative(Name))
+        return FString();
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FactorySpawner"), Name + TEXT(".fsplan"));
+}
+
+bool FBuildPlan::SaveToFile(const FString& Path, FString& OutError) const
+{
+    FPlanFileHeader Header;
+    Header.BuildableLayout = GetBuildableLayout();
+    Header.NumBuildables = Buildables.Num();
+    Header.NumConnections = Connections.Num();
+    Header.NumClassPaths = ClassPaths.Num();
+    Header.BuildablesOffset = sizeof(FPlanFileHeader);
+    Header.ConnectionsOffset = Header.BuildablesOffset + Buildables.Num() * sizeof(FPlannedBuildable);
+    Header.ClassPathsOffset = Header.ConnectionsOffset + Connections.Num() * sizeof(FPlannedConnection);
+
+    TArray<uint8> Data;
+    Data.Reserve(Header.ClassPathsOffset + ClassPaths.Num() * 64);
+    Data.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+    Data.Append(reinterpret_cast<const uint8*>(Buildables.GetData()), Buildables.Num() * sizeof(FPlannedBuildable));
+    Data.Append(reinterpret_cast<const uint8*>(Connections.GetData()),
+                Connections.Num() * sizeof(FPlannedConnection));
+    for (const FString& ClassPath : ClassPaths)
+    {
+        FTCHARToUTF8 Utf8(*ClassPath);
+        const int32 Length = Utf8.Length();
+        Data.Append(reinterpret_cast<const uint8*>(&Length), sizeof(Length));
+        Data.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Length);
+    }
+
+    if (!FFileHelper::SaveArrayToFile(Data, *Path))
+    {
+        OutError = FString::Printf(TEXT("Cannot write '%s'"), *Path);
+        return false;
+    }
+    return true;
+}
+
+FMappedBuildPlan::~FMappedBuildPlan() = default;
+
+TUniquePtr<FMappedBuildPlan> FMappedBuildPlan::Open(const FString& Path, FString& OutError)
+{
+    TUniquePtr<FMappedBuildPlan> Plan(new FMappedBuildPlan());
+
+    Plan->Handle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+    if (Plan->Handle)
+        Plan->Region.Reset(Plan->Handle->MapRegion(0, Plan->Handle->GetFileSize()));
+
+    const uint8* Data = nullptr;
+    int64 Size = 0;
+    if (Plan->Region)
+    {
+        Data = Plan->Region->GetMappedPtr();
+        Size = Plan->Region->GetMappedSize();
+    }
+    else if (FFileHelper::LoadFileToArray(Plan->FileData, *Path, FILEREAD_Silent))
+    {
+        Data = Plan->FileData.GetData();
+        Size = Plan->FileData.Num();
+    }
+    else
+    {
+        OutError = FString::Printf(TEXT("Cannot open '%s'"), *Path);
+        return nullptr;
+    }
+
+    if (!Plan->Init(Data, Size, OutError))
+        return nullptr;
+    return Plan;
+}
+
+bool FMappedBuildPlan::Init(const uint8* Data, int64 Size, FString& OutError)
+{
+    FPlanFileHeader Header;
+    if (Size < (int64) sizeof(Header))
+    {
+        OutError = TEXT("Not a plan file");
+        return false;
+    }
+    FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+    if (Header.Magic != PlanFileMagic)
+    {
+        OutError = TEXT("Not a plan file");
+        return false;
+    }
+    if (Header.Version != PlanFileVersion || Header.BuildableLayout != GetBuildableLayout())
+    {
+        OutError = TEXT("Plan was saved by another FactorySpawner version, save it again");
+        return false;
+    }
+
+    const int64 BuildablesEnd = Header.BuildablesOffset + (int64) Header.NumBuildables * sizeof(FPlannedBuildable);
+    const int64 ConnectionsEnd =
+        Header.ConnectionsOffset + (int64) Header.NumConnections * sizeof(FPlannedConnection);
+    if (Header.NumBuildables < 0 || Header.NumConnections < 0 || Header.NumClassPaths < 0 || BuildablesEnd > Size ||
+        ConnectionsEnd > Size || Header.ClassPathsOffset > Size ||
+        Header.BuildablesOffset % alignof(FPlannedBuildable) || Header.ConnectionsOffset % alignof(FPlannedConnection))
+    {
+        OutError = TEXT("Plan file is damaged");
+        return false;
+    }
+
+    Buildables = MakeArrayView(reinterpret_cast<const FPlannedBuildable*>(Data + Header.BuildablesOffset),
+                               Header.NumBuildables);
+    Connections = MakeArrayView(reinterpret_cast<const FPlannedConnection*>(Data + Header.ConnectionsOffset),
+                                Header.NumConnections);
+
+    int64 Offset = Header.ClassPathsOffset;
+    ClassPaths.Reserve(Header.NumClassPaths);
+    for (int32 i = 0; i < Header.NumClassPaths; ++i)
+    {
+        int32 Length = 0;
+        if (Offset + (int64) sizeof(Length) > Size)
+            break;
+        FMemory::Memcpy(&Length, Data + Offset, sizeof(Length));
+        Offset += sizeof(Length);
+        if (Length < 0 || Offset + Length > Size)
+            break;
+
+        FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Data + Offset), Length);
+        ClassPaths.Emplace(Converted.Length(), Converted.Get());
+        Offset += Length;
+    }
+
+    // The records are used as they are, so check every index once
+    bool bValid = ClassPaths.Num() == Header.NumClassPaths;
+    for (const FPlannedBuildable& Buildable : Buildables)
+        bValid &= Buildable.Type < EBuildable::Invalid && Buildable.ClassPath >= INDEX_NONE &&
+                  Buildable.ClassPath < ClassPaths.Num() && Buildable.MachineClass >= INDEX_NONE &&
+                  Buildable.MachineClass < ClassPaths.Num();
+    for (const FPlannedConnection& Connection : Connections)
+        bValid &= Buildables.IsValidIndex(Connection.From) && Buildables.IsValidIndex(Connection.To) &&
+                  Connection.Type <= EPlannedLink::PowerLine;
+
+    if (!bValid)
+    {
+        OutError = TEXT("Plan file is damaged");
+        return false;
+    }
+    return true;
+}
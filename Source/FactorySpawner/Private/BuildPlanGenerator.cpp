@@ -1,64 +1,112 @@
 #include "BuildPlanGenerator.h"
 #include "BuildableCache.h"
-#include "FactoryCommandParser.h"
-#include "FGBlueprintSubsystem.h"
+#include "PowerPlanner.h"
+#include "GeneratorFuel.h"
+#include "ClockPlanner.h"
+#include "FactorySpawner.h"
+#include "RowSimulator.h"
 #include "Buildables/FGBuildableManufacturer.h"
-#include "Tests/FGTestBlueprintFunctionLibrary.h"
-#include "FGPlayerController.h"
-#include "FGCharacterPlayer.h"
-#include "FGPowerConnectionComponent.h"
-#include "Buildables/FGBuildableWire.h"
-#include "Buildables/FGBuildablePowerPole.h"
-#include "FGFactoryConnectionComponent.h"
-#include "Buildables/FGBuildableConveyorBelt.h"
-#include "Buildables/FGBuildableConveyorLift.h"
-#include "Buildables/FGBuildablePipeline.h"
-#include "FGPipeConnectionComponent.h"
 #include "FGRecipe.h"
+#include "Resources/FGItemDescriptor.h"
+#include "Misc/MemStack.h"
 
 namespace
 {
-    const FQuat Rot180 = FQuat(FVector::UpVector, PI);
+    // Wall outlets hang on an 8 x 4 m wall just before the first machine of the row, facing away from it
+    constexpr float WallOutletHeight = 300.0f;
+    constexpr float WallWidth = 800.0f;
+    constexpr float WallThickness = 50.0f;
+    constexpr float WallGap = 50.0f;
 
-    FTransform MoveTransform(const FVector& Offset, bool bFlip = false)
+    // Foundations are 8 m squares, anchored at the center of their top face
+    constexpr float FoundationSize = 800.0f;
+
+    // Fluid buffers of production machines in m³
+    constexpr float FluidBufferSize = 50.0f;
+
+    // Port assignment: a lift costs as much as this much extra belt
+    constexpr float LiftPenalty = 1000.0f;
+
+    float GetLinkCost(const FVector& From, const FVector& To)
     {
-        FTransform Base = FTransform::Identity;
-        const FVector NewLoc = Base.TransformPosition(Offset);
-        const FQuat NewRot = bFlip ? Rot180 * Base.GetRotation() : Base.GetRotation();
-        return FTransform(NewRot, NewLoc);
+        return ShouldUseLift(From, To) ? FMath::Abs(From.Z - To.Z) + LiftPenalty : FVector::Distance(From, To);
     }
 
-    template <typename T> TArray<T*> GetConnections(AFGBuildable* Buildable)
+    void VisitPermutations(TArrayView<int32> Values, int32 First, TFunctionRef<void()> Visit)
     {
-        TArray<T*> Out;
-        Buildable->GetComponents<T>(Out);
-        return Out;
+        if (First >= Values.Num() - 1)
+        {
+            Visit();
+            return;
+        }
+        for (int32 i = First; i < Values.Num(); ++i)
+        {
+            Swap(Values[First], Values[i]);
+            VisitPermutations(Values, First + 1, Visit);
+            Swap(Values[First], Values[i]);
+        }
     }
 
     /**
-     * Calculate the variant index based on port requirements.
-     * The variants are ordered by pipe count (descending), then belt count (descending).
-     *
-     * @param MaxBelt Maximum available belt ports
-     * @param MaxPipe Maximum available pipe ports
-     * @param NeededBelt Required belt ports for the recipe
-     * @param NeededPipe Required pipe ports for the recipe
-     * @return The index of the variant in the configuration array
-     *
-     * Example: MaxBelt=2, MaxPipe=2
-     *   Index 0: (2 pipe, 2 belt)
-     *   Index 1: (2 pipe, 1 belt)
-     *   Index 2: (2 pipe, 0 belt)
-     *   Index 3: (1 pipe, 2 belt)
-     *   Index 4: (1 pipe, 1 belt)
-     *   Index 5: (1 pipe, 0 belt)
+     * Tries every assignment of the machine ports of Connectors to their lanes (manifold position and height) and
+     * keeps the one with the shortest links. Lanes at the same height keep the order of their ports, so belts on
+     * one level do not cross. The assignment of the config wins ties. Returns the saved length in cm.
      */
-    int32 GetPortVariantIndex(int32 MaxBelt, int32 MaxPipe, int32 NeededBelt, int32 NeededPipe)
+    template <typename FGetLaneLocation>
+    float AssignPorts(TArray<FConnector>& Connectors, TConstArrayView<FVector> Ports, bool bFlipped,
+                      FGetLaneLocation GetLaneLocation)
     {
-        const int32 NumBeltVariants = MaxBelt + 1;
-        const int32 BeltOffset = MaxBelt - NeededBelt;
-        const int32 PipeOffset = MaxPipe - NeededPipe;
-        return PipeOffset * NumBeltVariants + BeltOffset;
+        const int32 Num = Connectors.Num();
+        if (Num < 2 || Connectors.ContainsByPredicate([&](const FConnector& Conn)
+                                                      { return !Ports.IsValidIndex(Conn.Index); }))
+            return 0.0f;
+
+        auto GetPort = [&](int32 Index)
+        { return bFlipped ? FVector(-Ports[Index].X, -Ports[Index].Y, Ports[Index].Z) : Ports[Index]; };
+
+        TArray<int32, TInlineAllocator<8>> Indices;
+        for (const FConnector& Conn : Connectors)
+            Indices.Add(Conn.Index);
+
+        auto GetCost = [&]()
+        {
+            float Cost = 0.0f;
+            for (int32 k = 0; k < Num; ++k)
+                Cost += GetLinkCost(GetLaneLocation(Connectors[k]), GetPort(Indices[k]));
+            return Cost;
+        };
+        auto IsUncrossed = [&]()
+        {
+            for (int32 a = 0; a < Num; ++a)
+            {
+                for (int32 b = a + 1; b < Num; ++b)
+                {
+                    if (Connectors[a].LocationY == Connectors[b].LocationY &&
+                        (Connectors[a].LocationX < Connectors[b].LocationX) !=
+                            (GetPort(Indices[a]).X < GetPort(Indices[b]).X))
+                        return false;
+                }
+            }
+            return true;
+        };
+
+        const float ConfigCost = GetCost();
+        float BestCost = ConfigCost;
+        TArray<int32, TInlineAllocator<8>> Best = Indices;
+        VisitPermutations(Indices, 0,
+                          [&]()
+                          {
+                              const float Cost = GetCost();
+                              if (Cost < BestCost - 1.0f && IsUncrossed())
+                              {
+                                  BestCost = Cost;
+                                  Best = Indices;
+                              }
+                          });
+
+        for (int32 k = 0; k < Num; ++k)
+            Connectors[k].Index = Best[k];
+        return ConfigCost - BestCost;
     }
 
     // Machine configuration map (use helper factories from header)
@@ -153,68 +201,176 @@ FBuildPlanGenerator::FBuildPlanGenerator(UWorld* InWorld, UBuildableCache* InCac
 {
     World = InWorld;
     Cache = InCache;
-    AFGPlayerController* PC = Cast<AFGPlayerController>(World->GetFirstPlayerController());
-    Player = Cast<AFGCharacterPlayer>(PC->GetCharacter());
-    RCO = PC->GetRemoteCallObjectOfClass<UFGManufacturerClipboardRCO>();
+}
+
+const FMachineConfig* FBuildPlanGenerator::FindMachineConfig(EBuildable MachineType)
+{
+    return MachineConfigList.Find(MachineType);
+}
+
+FMachineConfig FBuildPlanGenerator::DeriveMachineConfig(const FMachinePorts& Ports)
+{
+    FMachineConfig Config;
+    const FVector Size = Ports.Footprint.GetSize();
+    Config.Width = FMath::CeilToInt(Size.X / 100.0f);
+    Config.Length = FMath::CeilToInt(Size.Y / 100.0f);
+
+    // Ports of one direction from left to right
+    auto GetSortedPorts = [](TConstArrayView<FVector> Locations, const TArray<bool>& IsInput, bool bInput)
+    {
+        TArray<int32> Indices;
+        for (int32 i = 0; i < Locations.Num(); ++i)
+        {
+            if (IsInput.IsValidIndex(i) && IsInput[i] == bInput)
+                Indices.Add(i);
+        }
+        Indices.Sort([Locations](int32 A, int32 B) { return Locations[A].X < Locations[B].X; });
+        return Indices;
+    };
+
+    // Lanes run 2 m beyond the clearance box, like those of the hand-made layouts
+    auto AddVariants = [&](TArray<FMachineConnections>& OutVariants, bool bInput, float Extent)
+    {
+        const TArray<int32> Belt = GetSortedPorts(Ports.Belt, Ports.BeltIsInput, bInput);
+        const TArray<int32> Pipe = GetSortedPorts(Ports.Pipe, Ports.PipeIsInput, bInput);
+        const int32 Length = FMath::CeilToInt(Extent / 100.0f) + 4;
+
+        // Same order as GetPortVariantIndex: fewer pipes, then fewer belts
+        for (int32 NumPipe = Pipe.Num(); NumPipe >= 0; --NumPipe)
+        {
+            for (int32 NumBelt = Belt.Num(); NumBelt >= 0; --NumBelt)
+            {
+                FMachineConnections& Variant = OutVariants.AddDefaulted_GetRef();
+                Variant.Length = Length;
+                for (int32 k = 0; k < NumBelt; ++k)
+                    Variant.Belt.Add(FConnector(Belt[k], FMath::RoundToInt(Ports.Belt[Belt[k]].X / 100.0f), k * 2));
+                for (int32 k = 0; k < NumPipe; ++k)
+                    Variant.Pipe.Add(FConnector(Pipe[k], FMath::RoundToInt(Ports.Pipe[Pipe[k]].X / 100.0f),
+                                                (NumBelt + k) * 2));
+            }
+        }
+    };
+
+    AddVariants(Config.InputConnections, true, -Ports.Footprint.Min.Y);
+    AddVariants(Config.OutputConnections, false, Ports.Footprint.Max.Y);
+    return Config;
 }
 
 void FBuildPlanGenerator::Generate(const TArray<FFactoryCommandToken>& ClusterConfig)
 {
-    YCursor = XCursor = FirstMachineWidth = 0;
-    CachedPowerConnections = {};
+    FPlanCapacity Capacity;
+    for (const FFactoryCommandToken& RowConfig : ClusterConfig)
+        AddCapacity(RowConfig, Cache, Capacity);
+
+    Begin(Capacity);
+    for (const FFactoryCommandToken& RowConfig : ClusterConfig)
+        AddRow(RowConfig);
+    Finish();
+}
 
-    for (int32 i = 0; i < ClusterConfig.Num(); ++i)
-        ProcessRow(ClusterConfig[i], i);
+void FBuildPlanGenerator::AddCapacity(const FFactoryCommandToken& RowConfig, UBuildableCache* Cache,
+                                      FPlanCapacity& InOutCapacity)
+{
+    if (RowConfig.Count <= 0)
+        return;
+    const FMachineConfig* Config = Cache->GetMachineConfig(RowConfig.MachineType, RowConfig.MachineClass);
+    if (!Config)
+        return;
+
+    // The first port variant has the most ports
+    int32 Ports = 0;
+    if (Config->InputConnections.Num() > 0)
+        Ports += Config->InputConnections[0].Belt.Num() + Config->InputConnections[0].Pipe.Num();
+    if (Config->OutputConnections.Num() > 0)
+        Ports += Config->OutputConnections[0].Belt.Num() + Config->OutputConnections[0].Pipe.Num();
+
+    // Per machine: a splitter, merger or cross per port and at most one pole; a manifold link and a machine link
+    // per port, one power line to the pole or the previous machine and one between poles
+    InOutCapacity.Buildables += RowConfig.Count * (Ports + 2);
+    InOutCapacity.Connections += RowConfig.Count * (Ports * 2 + 2);
+    InOutCapacity.PowerConsumers += RowConfig.Count;
+
+    // Foundation tiles, one more in each direction for the grid alignment
+    if (RowConfig.FloorHeight > 0)
+    {
+        const int32 Length = Config->InputConnections[0].Length + Config->OutputConnections[0].Length;
+        InOutCapacity.Buildables += (FMath::CeilToInt(RowConfig.Count * Config->Width / 8.0f) + 1) *
+                                    (FMath::CeilToInt(Length / 8.0f) + 1);
+    }
+}
 
-    AFGBlueprintSubsystem* BlueprintSubsystem = AFGBlueprintSubsystem::Get(World);
-    UFGBlueprintDescriptor* ExistingDescriptor =
-        BlueprintSubsystem->GetBlueprintDescriptorByNameString(TEXT("FactorySpawner"));
-    if (ExistingDescriptor)
-        BlueprintSubsystem->DeleteBlueprintDescriptor(ExistingDescriptor);
+void FBuildPlanGenerator::Begin(const FPlanCapacity& Capacity)
+{
+    NumRows = YCursor = XCursor = FirstMachineWidth = 0;
+    FloorTiles.Reset();
+    PowerConsumers.Reset(Capacity.PowerConsumers);
+    LastMachine = INDEX_NONE;
+    BeltTier = RowBeltTier = Cache->GetBeltTier();
+    PipelineTier = RowPipelineTier = Cache->GetPipelineTier();
+    TotalPowerOutput = 0.0f;
+    Plan.Reset();
+    Plan.Reserve(Capacity.Buildables, Capacity.Connections);
+}
 
-    FBlueprintRecord Record;
-    Record.BlueprintName = TEXT("FactorySpawner");
-    Record.BlueprintDescription = TEXT("Auto-generated blueprint");
-    Record.Color = FLinearColor::White;
+void FBuildPlanGenerator::AddRow(const FFactoryCommandToken& RowConfig)
+{
+    ProcessRow(RowConfig, NumRows++);
+}
+
+void FBuildPlanGenerator::Finish()
+{
+    PlanPowerNetwork();
 
-    BlueprintSubsystem->WriteBlueprintToArchive(Record, FTransform::Identity, BuildablesForBlueprint,
-                                                FIntVector(1, 1, 1));
-    BlueprintSubsystem->RefreshBlueprintsAndDescriptors();
+    if (TotalPowerOutput > 0.0f)
+        FFactorySpawnerModule::ChatLog(World,
+                                       FString::Printf(TEXT("Total power output: %.0f MW"), TotalPowerOutput));
+}
 
-    for (AFGBuildable* Buildable : BuildablesForBlueprint)
-        Buildable->Destroy();
+void FBuildPlanGenerator::Abort()
+{
+    Plan.Reset();
 }
 
 void FBuildPlanGenerator::ProcessRow(const FFactoryCommandToken& RowConfig, int32 RowIndex)
 {
-    const FMachineConfig& Config = MachineConfigList[RowConfig.MachineType];
+    const FMachineConfig* FoundConfig = Cache->GetMachineConfig(RowConfig.MachineType, RowConfig.MachineClass);
+    if (!FoundConfig)
+    {
+        FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Row %d: no ports found for this machine"),
+                                                              RowIndex + 1));
+        return;
+    }
+    const FMachineConfig& Config = *FoundConfig;
     int32 InputVariant = 0, OutputVariant = 0;
-
-    if (RowConfig.Recipe.IsSet() && RowConfig.MachineType != EBuildable::CoalGenerator &&
-        RowConfig.MachineType != EBuildable::FuelGenerator && RowConfig.MachineType != EBuildable::NuclearReactor)
+    float BaseRate = 0.0f;
+    int32 Recipe = INDEX_NONE;
+    TOptional<FRecipeDescriptor> Descriptor;
+
+    // A custom machine may be any buildable with ports, only manufacturers take a recipe
+    UClass* Class = Cache->GetMachineClass(RowConfig.MachineType, RowConfig.MachineClass);
+    TSubclassOf<AFGBuildableManufacturer> MachineClass =
+        Class && Class->IsChildOf<AFGBuildableManufacturer>() ? Class : nullptr;
+    if (RowConfig.Recipe.IsSet() && !IsGenerator(RowConfig.MachineType) && !MachineClass)
+        FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Row %d: %s takes no recipe, building it without"),
+                                                              RowIndex + 1, *GetNameSafe(Class)));
+    else if (RowConfig.Recipe.IsSet() && !IsGenerator(RowConfig.MachineType))
     {
-        TSubclassOf<AFGBuildableManufacturer> MachineClass =
-            Cache->GetBuildableClass<AFGBuildableManufacturer>(RowConfig.MachineType);
         TSubclassOf<UFGRecipe> RecipeClass = Cache->GetRecipeClass(RowConfig.Recipe.GetValue(), MachineClass, World);
 
         if (RecipeClass)
         {
-            int32 SolidIn = 0, LiquidIn = 0, SolidOut = 0, LiquidOut = 0;
-            for (const FItemAmount& Item : RecipeClass->GetDefaultObject<UFGRecipe>()->GetIngredients())
-                UFGItemDescriptor::GetForm(Item.ItemClass) == EResourceForm::RF_SOLID ? ++SolidIn : ++LiquidIn;
-            for (const FItemAmount& Item : RecipeClass->GetDefaultObject<UFGRecipe>()->GetProducts())
-                UFGItemDescriptor::GetForm(Item.ItemClass) == EResourceForm::RF_SOLID ? ++SolidOut : ++LiquidOut;
-
-            int32 MaxBeltInput = Config.InputConnections[0].Belt.Num();
-            int32 MaxPipeInput = Config.InputConnections[0].Pipe.Num();
-            InputVariant = GetPortVariantIndex(MaxBeltInput, MaxPipeInput, SolidIn, LiquidIn);
-
-            int32 MaxBeltOutput = Config.OutputConnections[0].Belt.Num();
-            int32 MaxPipeOutput = Config.OutputConnections[0].Pipe.Num();
-            OutputVariant = GetPortVariantIndex(MaxBeltOutput, MaxPipeOutput, SolidOut, LiquidOut);
+            Descriptor = Cache->GetRecipeDescriptor(RecipeClass, Config);
+            InputVariant = Descriptor->InputVariant;
+            OutputVariant = Descriptor->OutputVariant;
+            BaseRate = Descriptor->GetBaseRate();
+            Recipe = Plan.AddClassPath(RecipeClass->GetPathName());
         }
     }
 
+    FClockPlan ClockPlan;
+    if (!PlanClocks(RowConfig, RowIndex, BaseRate, ClockPlan))
+        return;
+
     const FMachineConnections& InputConn = Config.InputConnections[InputVariant];
     const FMachineConnections& OutputConn = Config.OutputConnections[OutputVariant];
 
@@ -226,314 +382,520 @@ void FBuildPlanGenerator::ProcessRow(const FFactoryCommandToken& RowConfig, int3
         XCursor = FMath::CeilToInt((Config.Width * 100 - FirstMachineWidth) / 2.0f / 100) * 100;
     }
 
-    PlaceMachines(RowConfig, Config.Width * 100, Config.Length * 100, InputConn, OutputConn);
+    // Generator rows may use smaller manifolds than the command's tiers
+    RowBeltTier = BeltTier;
+    RowPipelineTier = PipelineTier;
+    if (IsGenerator(RowConfig.MachineType))
+        PlanGeneratorRow(RowConfig, RowIndex, Config);
+
+    TArray<int32> FilterItems;
+    if (RowConfig.bMixedInputs && Descriptor)
+        PlanMixedInputs(RowIndex, *Descriptor, ClockPlan, FilterItems);
+    const bool bMixedInputs = FilterItems.Num() > 0;
+
+    const FVector2D RowStart(XCursor - Config.Width * 50, YCursor - InputConn.Length * 100);
+    PlaceMachines(RowConfig, RowIndex, Recipe, ClockPlan,
+                  GetMachineCell(RowConfig.MachineType, RowConfig.MachineClass, InputVariant, OutputVariant,
+                                 bMixedInputs),
+                  Config.Width * 100, FilterItems);
     YCursor += OutputConn.Length * 100;
-    CachedPowerConnections.LastMachine = CachedPowerConnections.LastPole = nullptr;
+
+    if (RowConfig.FloorHeight > 0 && ClockPlan.MachineCount > 0)
+        PlaceFloor(RowConfig, RowIndex, FBox2D(RowStart, FVector2D(XCursor - Config.Width * 50, YCursor)));
+
+    if (Descriptor)
+        SimulateRow(RowConfig, RowIndex, *Descriptor, ClockPlan, Config, bMixedInputs);
 }
 
-void FBuildPlanGenerator::PlaceMachines(const FFactoryCommandToken& RowConfig, int32 Width, int32 Length,
-                                        const FMachineConnections& InputConnections,
-                                        const FMachineConnections& OutputConnections)
+void FBuildPlanGenerator::PlanMixedInputs(int32 RowIndex, const FRecipeDescriptor& Descriptor,
+                                          const FClockPlan& ClockPlan, TArray<int32>& OutFilterItems)
 {
-    ConnectionQueue.Input.Empty();
-    ConnectionQueue.Output.Empty();
-    ConnectionQueue.PipeInput.Empty();
-    ConnectionQueue.PipeOutput.Empty();
+    if (Descriptor.SolidIn < 2)
+    {
+        FFactorySpawnerModule::ChatLog(
+            World, FString::Printf(TEXT("Row %d: inputs=mixed needs a recipe with two or more solid ingredients"),
+                                   RowIndex + 1));
+        return;
+    }
 
-    for (int32 i = 0; i < RowConfig.Count; ++i)
+    // Machines take what they need from the mixed belt, so it has to carry the whole row's consumption
+    float Clock = 0.0f;
+    for (int32 i = 0; i < ClockPlan.MachineCount; ++i)
+        Clock += ClockPlan.GetClockPercent(i) / 100.0f;
+    float BeltRate = 0.0f;
+    for (const FRecipeItemRate& Rate : Descriptor.Ingredients)
+        BeltRate += Rate.bFluid ? 0.0f : Rate.PerMinute * Clock;
+
+    if (BeltRate > GetBeltThroughput(RowBeltTier))
     {
-        CalculateMachineSetup(RowConfig.MachineType, RowConfig.Recipe, RowConfig.ClockPercent, Width, Length,
-                              InputConnections, OutputConnections, i == 0, i % 2 == 0, i == RowConfig.Count - 1);
-        XCursor += Width;
+        FFactorySpawnerModule::ChatLog(
+            World, FString::Printf(TEXT("Row %d: a mixed input belt needs %.1f/min, Mk%d belts carry %.0f/min. "
+                                        "Using one belt per ingredient"),
+                                   RowIndex + 1, BeltRate, RowBeltTier, GetBeltThroughput(RowBeltTier)));
+        return;
+    }
+
+    for (const FRecipeItemRate& Rate : Descriptor.Ingredients)
+    {
+        if (!Rate.bFluid && Rate.Item)
+            OutFilterItems.Add(Plan.AddClassPath(Rate.Item->GetPathName()));
     }
+    FFactorySpawnerModule::ChatLog(
+        World, FString::Printf(TEXT("Row %d: %d ingredients on one mixed belt, %.1f/min in the recipe's ratio"),
+                               RowIndex + 1, OutFilterItems.Num(), BeltRate));
 }
-void FBuildPlanGenerator::CalculateMachineSetup(EBuildable MachineType, const TOptional<FString>& Recipe,
-                                                const TOptional<float>& Underclock, int32 Width, int32 Length,
-                                                const FMachineConnections& InputConnections,
-                                                const FMachineConnections& OutputConnections, bool bFirstUnitInRow,
-                                                bool bEvenIndex, bool bLastIndex)
+
+void FBuildPlanGenerator::SimulateRow(const FFactoryCommandToken& RowConfig, int32 RowIndex,
+                                      const FRecipeDescriptor& Descriptor, const FClockPlan& ClockPlan,
+                                      const FMachineConfig& Config, bool bMixedInputs)
 {
-    UFGPowerConnectionComponent* MachinePowerConn;
-    TArray<UFGFactoryConnectionComponent*> MachineBeltConn;
-    TArray<UFGPipeConnectionComponent*> MachinePipeConn;
-    SpawnMachine(FVector(XCursor, YCursor, 0), MachineType, Recipe, Underclock, MachinePowerConn, MachineBeltConn,
-                 MachinePipeConn);
-
-    if (!bEvenIndex)
-    {
-        if (bLastIndex && CachedPowerConnections.LastPole)
-            SpawnWireAndConnect(CachedPowerConnections.LastPole, MachinePowerConn);
-        else
-            CachedPowerConnections.LastMachine = MachinePowerConn;
+    if (Descriptor.Duration <= 0.0f || ClockPlan.ClockPercent <= 0.0f)
+        return;
+
+    auto ToSimulatedItem = [&Descriptor](const FRecipeItemRate& Rate)
+    {
+        FSimulatedItem Item;
+        Item.PerCycle = Rate.PerMinute * Descriptor.Duration / 60.0f;
+        Item.bFluid = Rate.bFluid;
+        Item.StackSize = Rate.bFluid ? FluidBufferSize : (float) UFGItemDescriptor::GetStackSize(Rate.Item);
+        return Item;
+    };
+
+    FRowSimulationInput Input;
+    Input.Machines = ClockPlan.MachineCount;
+    const int32 Slots = FClockPlanner::GetSomersloopSlots(RowConfig.MachineType);
+    for (int32 i = 0; i < ClockPlan.MachineCount; ++i)
+    {
+        Input.CycleSeconds.Add(Descriptor.Duration * 100.0f / ClockPlan.GetClockPercent(i));
+        Input.ProductionBoost.Add(ClockPlan.GetProductionBoost(i, Slots));
     }
-    else
+    float SolidPerMinute = 0.0f;
+    for (const FRecipeItemRate& Rate : Descriptor.Ingredients)
+        SolidPerMinute += Rate.bFluid ? 0.0f : Rate.PerMinute;
+    for (const FRecipeItemRate& Rate : Descriptor.Ingredients)
     {
-        FVector PoleLocation = FVector(XCursor - Width / 2.0f, YCursor - Length / 2.0f, 0);
-        UFGPowerConnectionComponent* Pole = SpawnPowerPole(PoleLocation);
-        SpawnWireAndConnect(Pole, MachinePowerConn);
+        FSimulatedItem& Item = Input.Ingredients.Add_GetRef(ToSimulatedItem(Rate));
+        if (bMixedInputs && !Rate.bFluid)
+            Item.BeltShare = Rate.PerMinute / SolidPerMinute;
+    }
+    for (const FRecipeItemRate& Rate : Descriptor.Products)
+        Input.Products.Add(ToSimulatedItem(Rate));
+    Input.MachineSpacing = Config.Width;
+    Input.BeltRate = GetBeltThroughput(RowBeltTier);
+    Input.PipeRate = GetPipeThroughput(RowPipelineTier);
+
+    const FRowSimulationResult Result = FRowSimulator::Simulate(Input);
+    UE_LOG(LogFactorySpawner, Verbose, TEXT("Row %d: simulated %.0f s in %.2f ms"), RowIndex + 1,
+           Result.SimulatedSeconds, Result.CpuMilliseconds);
+    FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Row %d simulated: %s"), RowIndex + 1,
+                                                          *FRowSimulator::GetSummary(Result)));
+}
+bool FBuildPlanGenerator::PlanClocks(const FFactoryCommandToken& RowConfig, int32 RowIndex, float BaseRate,
+                                     FClockPlan& OutPlan)
+{
+    const FString MachineName = StaticEnum<EBuildable>()->GetNameStringByValue((int64) RowConfig.MachineType);
+    const float MaxClock = RowConfig.ClockPercent.Get(FClockPlanner::MaxClockPercent);
 
-        if (bFirstUnitInRow)
+    if (RowConfig.TargetRate.IsSet() && BaseRate > 0.0f)
+    {
+        const int32 MaxMachines = RowConfig.Count > 0 ? FMath::Min(RowConfig.Count, FClockPlanner::MaxMachinesPerRow)
+                                                      : FClockPlanner::MaxMachinesPerRow;
+        const float TargetRate = RowConfig.TargetRate.GetValue();
+        bool bReached = FClockPlanner::PlanForRate(RowConfig.MachineType, BaseRate, TargetRate, MaxMachines, MaxClock,
+                                                   RowConfig.Somersloops, OutPlan);
+        if (!bReached && MaxMachines == FClockPlanner::MaxMachinesPerRow)
         {
-            if (CachedPowerConnections.FirstPole)
-                SpawnWireAndConnect(Pole, CachedPowerConnections.FirstPole);
-            CachedPowerConnections.FirstPole = Pole;
+            FFactorySpawnerModule::ChatLog(
+                World, FString::Printf(TEXT("Row %d: %.1f/min needs more than %d %s, split it into several rows"),
+                                       RowIndex + 1, TargetRate, FClockPlanner::MaxMachinesPerRow, *MachineName));
+            return false;
         }
-        else
+        if (RowConfig.MinMachines > 0)
         {
-            if (CachedPowerConnections.LastMachine)
-                SpawnWireAndConnect(Pole, CachedPowerConnections.LastMachine);
-            if (CachedPowerConnections.LastPole)
-                SpawnWireAndConnect(Pole, CachedPowerConnections.LastPole);
+            // Compare against the fewest machines that reach the rate
+            const FClockPlan Fewest = OutPlan;
+            const bool bFewestReached = bReached;
+            bReached = FClockPlanner::PlanForPower(RowConfig.MachineType, BaseRate, TargetRate, RowConfig.MinMachines,
+                                                   MaxMachines, MaxClock, RowConfig.Somersloops, OutPlan);
+            if (bReached && bFewestReached)
+                FFactorySpawnerModule::ChatLog(
+                    World, FString::Printf(TEXT("Row %d: least power with %d machines saves %.1f MW compared with "
+                                                "%d at %.1f%%"),
+                                           RowIndex + 1, OutPlan.MachineCount, Fewest.PowerUsage - OutPlan.PowerUsage,
+                                           Fewest.MachineCount, Fewest.ClockPercent));
         }
-        CachedPowerConnections.LastPole = Pole;
+        if (!bReached)
+            FFactorySpawnerModule::ChatLog(
+                World, FString::Printf(TEXT("Row %d: %d %s reach only %.1f of %.1f/min!"), RowIndex + 1,
+                                       OutPlan.MachineCount, *MachineName, OutPlan.OutputRate, TargetRate));
     }
-
-    FVector MachineLocation(XCursor, YCursor, 0);
-
-    for (const FConnector& Conn : InputConnections.Belt)
+    else
     {
-        FVector Loc = MachineLocation +
-                      FVector(Conn.LocationX * 100, -InputConnections.Length * 100 + 200, 100 + Conn.LocationY * 100);
-        TArray<UFGFactoryConnectionComponent*> Splitter = SpawnSplitterOrMerger(Loc, EBuildable::Splitter);
-
-        if (!bFirstUnitInRow)
+        if (RowConfig.TargetRate.IsSet())
+            FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Row %d: rate needs a valid recipe, using the "
+                                                                       "machine count"),
+                                                                  RowIndex + 1));
+        if (RowConfig.Count <= 0)
+            return false;
+
+        // Fixed count and clock; somersloops go into the first machines
+        const int32 Slots = FClockPlanner::GetSomersloopSlots(RowConfig.MachineType);
+        OutPlan.MachineCount = RowConfig.Count;
+        OutPlan.ClockPercent = RowConfig.ClockPercent.Get(100.0f);
+        OutPlan.Somersloops.SetNumZeroed(RowConfig.Count);
+        int32 SloopsLeft = RowConfig.Somersloops;
+        for (int32 i = 0; i < RowConfig.Count && Slots > 0; ++i)
         {
-            UFGFactoryConnectionComponent* Prev;
-            if (ConnectionQueue.Input.Dequeue(Prev))
-                SpawnLiftOrBeltAndConnect(Prev, Splitter[1]);
+            OutPlan.Somersloops[i] = FMath::Min(Slots, SloopsLeft);
+            SloopsLeft -= OutPlan.Somersloops[i];
         }
-        ConnectionQueue.Input.Enqueue(Splitter[0]);
-        SpawnLiftOrBeltAndConnect(Splitter[3], MachineBeltConn[Conn.Index]);
+        FClockPlanner::Evaluate(RowConfig.MachineType, BaseRate, OutPlan);
     }
 
-    // NuclearReactor outputs are at the input side
-    for (const FConnector& Conn : OutputConnections.Belt)
+    if (RowConfig.TargetRate.IsSet() || RowConfig.Somersloops > 0 || OutPlan.ClockPercent > 100.0f)
     {
-        int32 YOffset = MachineType == EBuildable::NuclearReactor ? -InputConnections.Length * 100 + 200
-                                                                  : OutputConnections.Length * 100 - 200;
-        FVector Loc = MachineLocation + FVector(Conn.LocationX * 100, YOffset, 100 + Conn.LocationY * 100);
-        TArray<UFGFactoryConnectionComponent*> Merger = SpawnSplitterOrMerger(Loc, EBuildable::Merger);
-
-        if (!bFirstUnitInRow)
-        {
-            UFGFactoryConnectionComponent* Prev;
-            if (ConnectionQueue.Output.Dequeue(Prev))
-                SpawnLiftOrBeltAndConnect(Merger[1], Prev);
-        }
-        ConnectionQueue.Output.Enqueue(Merger[0]);
-        SpawnLiftOrBeltAndConnect(MachineBeltConn[Conn.Index],
-                                  MachineType == EBuildable::NuclearReactor ? Merger[3] : Merger[2]);
+        int32 UsedSloops = 0;
+        for (int32 Sloops : OutPlan.Somersloops)
+            UsedSloops += Sloops;
+
+        FString Clocks = FString::Printf(TEXT("%.1f%%"), OutPlan.ClockPercent);
+        if (OutPlan.LastClockPercent > 0.0f)
+            Clocks += FString::Printf(TEXT(" (last one %.1f%%)"), OutPlan.LastClockPercent);
+
+        FFactorySpawnerModule::ChatLog(
+            World, FString::Printf(TEXT("Row %d: %d %s at %s (%d shards each), %d somersloops: %.1f/min, %.1f MW"),
+                                   RowIndex + 1, OutPlan.MachineCount, *MachineName, *Clocks,
+                                   OutPlan.PowerShardsPerMachine, UsedSloops, OutPlan.OutputRate, OutPlan.PowerUsage));
     }
+    return true;
+}
 
-    for (const FConnector& Conn : InputConnections.Pipe)
-    {
-        FVector Loc = MachineLocation +
-                      FVector(Conn.LocationX * 100, -InputConnections.Length * 100 + 200, 175 + Conn.LocationY * 100);
-        TArray<UFGPipeConnectionComponent*> Cross = SpawnPipeCross(Loc);
+void FBuildPlanGenerator::PlanGeneratorRow(const FFactoryCommandToken& RowConfig, int32 RowIndex,
+                                           const FMachineConfig& Config)
+{
+    const FString GeneratorName = StaticEnum<EBuildable>()->GetNameStringByValue((int64) RowConfig.MachineType);
 
-        if (!bFirstUnitInRow)
+    const FGeneratorFuel* Fuel = nullptr;
+    if (RowConfig.Recipe.IsSet())
+    {
+        Fuel = FGeneratorFuels::Find(RowConfig.MachineType, RowConfig.Recipe.GetValue());
+        if (!Fuel)
         {
-            UFGPipeConnectionComponent* Prev;
-            if (ConnectionQueue.PipeInput.Dequeue(Prev))
-                SpawnPipeAndConnect(Prev, Cross[3]);
+            const FString FuelNames = FString::Join(FGeneratorFuels::GetFuelNames(RowConfig.MachineType), TEXT(", "));
+            FFactorySpawnerModule::ChatLog(World,
+                                           FString::Printf(TEXT("Fuel '%s' not found. Available fuels for %s: %s"),
+                                                           *RowConfig.Recipe.GetValue(), *GeneratorName, *FuelNames));
         }
-        ConnectionQueue.PipeInput.Enqueue(Cross[0]);
-        SpawnPipeAndConnect(MachinePipeConn[Conn.Index], Cross[1]);
     }
 
-    for (const FConnector& Conn : OutputConnections.Pipe)
+    const FGeneratorRowEstimate Estimate = FGeneratorFuels::Estimate(RowConfig.MachineType, Fuel, RowConfig.Count,
+                                                                     RowConfig.ClockPercent.Get(100.0f));
+    TotalPowerOutput += Estimate.PowerOutput;
+
+    if (!Fuel)
     {
-        FVector Loc = MachineLocation +
-                      FVector(Conn.LocationX * 100, OutputConnections.Length * 100 - 200, 175 + Conn.LocationY * 100);
-        TArray<UFGPipeConnectionComponent*> Cross = SpawnPipeCross(Loc);
+        FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Row %d: %d %s, %.0f MW"), RowIndex + 1,
+                                                              RowConfig.Count, *GeneratorName, Estimate.PowerOutput));
+        return;
+    }
 
-        if (!bFirstUnitInRow)
+    // The belt manifolds carry solid fuel in and nuclear waste out, the pipe manifold liquid fuel or water
+    const bool bHasPipe = Config.InputConnections[0].Pipe.Num() > 0;
+    const float BeltRate = FMath::Max(Fuel->bLiquid ? 0.0f : Estimate.FuelPerMinute, Estimate.WastePerMinute);
+    const float PipeRate = bHasPipe ? (Fuel->bLiquid ? Estimate.FuelPerMinute : Estimate.WaterPerMinute) : 0.0f;
+
+    // Use the smallest tier that keeps up; cheaper to build and the command's tier stays the upper limit
+    while (RowBeltTier > 1 && GetBeltThroughput(RowBeltTier - 1) >= BeltRate)
+        --RowBeltTier;
+    while (RowPipelineTier > 1 && GetPipeThroughput(RowPipelineTier - 1) >= PipeRate)
+        --RowPipelineTier;
+
+    FString Summary = FString::Printf(TEXT("Row %d: %d %s on %s at %.1f%%, %.1f/min fuel"), RowIndex + 1,
+                                      RowConfig.Count, *GeneratorName, *Fuel->Name,
+                                      RowConfig.ClockPercent.Get(100.0f), Estimate.FuelPerMinute);
+    if (Estimate.WaterPerMinute > 0.0f)
+        Summary += FString::Printf(TEXT(", %.1f m³/min water"), Estimate.WaterPerMinute);
+    if (Estimate.WastePerMinute > 0.0f)
+        Summary += FString::Printf(TEXT(", %.1f/min waste"), Estimate.WastePerMinute);
+    Summary += FString::Printf(TEXT(", %.0f MW"), Estimate.PowerOutput);
+    FFactorySpawnerModule::ChatLog(World, Summary);
+
+    if (BeltRate > GetBeltThroughput(BeltTier))
+        FFactorySpawnerModule::ChatLog(
+            World, FString::Printf(TEXT("Row %d: belt manifold needs %.1f/min, Mk%d belts carry %.0f/min. Use at "
+                                        "most %d generators per row!"),
+                                   RowIndex + 1, BeltRate, BeltTier, GetBeltThroughput(BeltTier),
+                                   FMath::FloorToInt(GetBeltThroughput(BeltTier) / (BeltRate / RowConfig.Count))));
+    if (PipeRate > GetPipeThroughput(PipelineTier))
+        FFactorySpawnerModule::ChatLog(
+            World, FString::Printf(TEXT("Row %d: pipe manifold needs %.1f m³/min, Mk%d pipes carry %.0f m³/min. Use "
+                                        "at most %d generators per row!"),
+                                   RowIndex + 1, PipeRate, PipelineTier, GetPipeThroughput(PipelineTier),
+                                   FMath::FloorToInt(GetPipeThroughput(PipelineTier) / (PipeRate / RowConfig.Count))));
+    if (!bHasPipe && Estimate.WaterPerMinute > 0.0f)
+        FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Row %d: connect %.1f m³/min of water manually"),
+                                                              RowIndex + 1, Estimate.WaterPerMinute));
+}
+
+void FBuildPlanGenerator::PlaceFloor(const FFactoryCommandToken& RowConfig, int32 RowIndex, const FBox2D& RowArea)
+{
+    const EBuildable Type = RowConfig.FloorHeight >= 4   ? EBuildable::Foundation4m
+                            : RowConfig.FloorHeight >= 2 ? EBuildable::Foundation2m
+                                                         : EBuildable::Foundation1m;
+
+    // Tiles touched by the row; an edge exactly on a grid line does not reach into the next tile
+    const FIntPoint First(FMath::FloorToInt(RowArea.Min.X / FoundationSize),
+                          FMath::FloorToInt(RowArea.Min.Y / FoundationSize));
+    const FIntPoint Last(FMath::CeilToInt(RowArea.Max.X / FoundationSize) - 1,
+                         FMath::CeilToInt(RowArea.Max.Y / FoundationSize) - 1);
+
+    for (int32 Y = First.Y; Y <= Last.Y; ++Y)
+    {
+        for (int32 X = First.X; X <= Last.X; ++X)
         {
-            UFGPipeConnectionComponent* Prev;
-            if (ConnectionQueue.PipeOutput.Dequeue(Prev))
-                SpawnPipeAndConnect(Prev, Cross[3]);
+            bool bPlaced = false;
+            FloorTiles.Add(FIntPoint(X, Y), &bPlaced);
+            if (!bPlaced)
+                Plan.AddBuildable(Type, FVector((X + 0.5f) * FoundationSize, (Y + 0.5f) * FoundationSize, 0.0f),
+                                  false, RowIndex);
         }
-        ConnectionQueue.PipeOutput.Enqueue(Cross[0]);
-        SpawnPipeAndConnect(MachinePipeConn[Conn.Index], Cross[2]);
     }
 }
 
-void FBuildPlanGenerator::SpawnWireAndConnect(UFGPowerConnectionComponent* A, UFGPowerConnectionComponent* B)
+void FBuildPlanGenerator::PlaceMachines(const FFactoryCommandToken& RowConfig, int32 RowIndex, int32 Recipe,
+                                        const FClockPlan& ClockPlan, const FMachineCell& Cell, int32 Width,
+                                        TConstArrayView<int32> FilterItems)
 {
-    TSubclassOf<AFGBuildableWire> PowerLineClass = Cache->GetBuildableClass<AFGBuildableWire>(EBuildable::PowerLine);
-    AFGBuildableWire* Wire = World->SpawnActor<AFGBuildableWire>(PowerLineClass, FTransform::Identity);
-    Wire->Connect(A, B);
-    BuildablesForBlueprint.Add(static_cast<AFGBuildable*>(Wire));
+    ManifoldEnds.SetNum(Cell.Manifolds.Num());
+
+    const int32 Slots = FClockPlanner::GetSomersloopSlots(RowConfig.MachineType);
+    const int32 MachineClass =
+        RowConfig.MachineClass.IsEmpty() ? INDEX_NONE : Plan.AddClassPath(RowConfig.MachineClass);
+
+    for (int32 i = 0; i < ClockPlan.MachineCount; ++i)
+    {
+        StampMachineCell(Cell, Recipe, MachineClass, ClockPlan.GetClockPercent(i),
+                         ClockPlan.GetProductionBoost(i, Slots), RowConfig.PowerScheme, RowIndex, i == 0, FilterItems);
+        XCursor += Width;
+    }
 }
 
-UFGPowerConnectionComponent* FBuildPlanGenerator::SpawnPowerPole(const FVector& Location)
+const FMachineCell& FBuildPlanGenerator::GetMachineCell(EBuildable MachineType, const FString& MachineClass,
+                                                        int32 InputVariant, int32 OutputVariant, bool bMixedInputs)
 {
-    const FTransform UnitTransform = MoveTransform(Location);
-    TSubclassOf<AFGBuildablePowerPole> PowerPoleClass =
-        Cache->GetBuildableClass<AFGBuildablePowerPole>(EBuildable::PowerPole);
-    AFGBuildablePowerPole* SpawnedPowerPole = World->SpawnActor<AFGBuildablePowerPole>(PowerPoleClass, UnitTransform);
-    BuildablesForBlueprint.Add(SpawnedPowerPole);
-    UFGPowerConnectionComponent* PolePowerConnection = SpawnedPowerPole->GetPowerConnection(0);
-    return PolePowerConnection;
+    const TPair<UClass*, uint32> Key(Cache->GetMachineClass(MachineType, MachineClass),
+                                     (uint32) bMixedInputs << 16 | (uint32) InputVariant << 8 | (uint32) OutputVariant);
+    if (const FMachineCell* Cell = MachineCells.Find(Key))
+        return *Cell;
+
+    const FMachinePorts& Ports = Cache->GetMachinePorts(MachineType, MachineClass);
+    const FMachineConfig& Config = *Ports.Config;
+    return MachineCells.Add(Key, BuildMachineCell(MachineType, Config.Width * 100, Config.Length * 100,
+                                                  Config.InputConnections[InputVariant],
+                                                  Config.OutputConnections[OutputVariant], Ports, bMixedInputs));
 }
 
-void FBuildPlanGenerator::SpawnMachine(const FVector& Location, EBuildable MachineType,
-                                       const TOptional<FString>& Recipe, const TOptional<float>& Underclock,
-                                       UFGPowerConnectionComponent*& outPowerConn,
-                                       TArray<UFGFactoryConnectionComponent*>& outBeltConn,
-                                       TArray<UFGPipeConnectionComponent*>& outPipeConn)
+FMachineCell FBuildPlanGenerator::BuildMachineCell(EBuildable MachineType, int32 Width, int32 Length,
+                                                   const FMachineConnections& InputConnections,
+                                                   const FMachineConnections& OutputConnections,
+                                                   const FMachinePorts& Ports, bool bMixedInputs)
 {
-    FTransform Transform =
-        MoveTransform(Location, MachineType == EBuildable::OilRefinery || MachineType == EBuildable::CoalGenerator ||
-                                    MachineType == EBuildable::NuclearReactor);
+    FMachineCell Cell;
+    const bool bFlipped = MachineType == EBuildable::OilRefinery || MachineType == EBuildable::CoalGenerator ||
+                          MachineType == EBuildable::NuclearReactor;
+    Cell.Buildables.Add({MachineType, FVector::ZeroVector, bFlipped});
+    Cell.PoleAnchor = FVector(-Width / 2.0f, -Length / 2.0f, 0);
 
-    AFGBuildable* Spawned = nullptr;
-
-    if (MachineType == EBuildable::CoalGenerator || MachineType == EBuildable::FuelGenerator ||
-        MachineType == EBuildable::NuclearReactor)
+    // NuclearReactor outputs are at the input side
+    const int32 InputY = -InputConnections.Length * 100 + 200;
+    const int32 OutputY =
+        MachineType == EBuildable::NuclearReactor ? InputY : OutputConnections.Length * 100 - 200;
+    auto GetInputBeltLane = [InputY](const FConnector& Conn)
+    { return FVector(Conn.LocationX * 100, InputY, 100 + Conn.LocationY * 100); };
+    auto GetMixedBeltLane = [InputY](const FConnector& Conn) { return FVector(Conn.LocationX * 100, InputY, 100); };
+    auto GetOutputBeltLane = [OutputY](const FConnector& Conn)
+    { return FVector(Conn.LocationX * 100, OutputY, 100 + Conn.LocationY * 100); };
+    auto GetInputPipeLane = [InputY](const FConnector& Conn)
+    { return FVector(Conn.LocationX * 100, InputY, 175 + Conn.LocationY * 100); };
+    auto GetOutputPipeLane = [&OutputConnections](const FConnector& Conn)
+    { return FVector(Conn.LocationX * 100, OutputConnections.Length * 100 - 200, 175 + Conn.LocationY * 100); };
+
+    // Which port feeds which lane is a choice: take the shortest links for this machine's port positions
+    TArray<FConnector> InputBelt = InputConnections.Belt;
+    TArray<FConnector> OutputBelt = OutputConnections.Belt;
+    TArray<FConnector> InputPipe = InputConnections.Pipe;
+    TArray<FConnector> OutputPipe = OutputConnections.Pipe;
+
+    // A mixed belt runs along one level through a smart splitter per solid port, from left to right
+    if (bMixedInputs)
     {
-        TSubclassOf<AFGBuildableFactory> Class = Cache->GetBuildableClass<AFGBuildableFactory>(MachineType);
-        Spawned = World->SpawnActor<AFGBuildableFactory>(Class, Transform);
+        for (FConnector& Conn : InputBelt)
+            Conn.LocationY = 0;
+        InputBelt.Sort([](const FConnector& A, const FConnector& B) { return A.LocationX < B.LocationX; });
     }
-    else
+
+    const float Saved = AssignPorts(InputBelt, Ports.Belt, bFlipped, GetInputBeltLane) +
+                        AssignPorts(OutputBelt, Ports.Belt, bFlipped, GetOutputBeltLane) +
+                        AssignPorts(InputPipe, Ports.Pipe, bFlipped, GetInputPipeLane) +
+                        AssignPorts(OutputPipe, Ports.Pipe, bFlipped, GetOutputPipeLane);
+    if (Saved > 0.0f)
+        UE_LOG(LogFactorySpawner, Log, TEXT("%s: reassigned ports, %.0f m less belt and pipe per machine"),
+               *StaticEnum<EBuildable>()->GetNameStringByValue((int64) MachineType), Saved / 100.0f);
+
+    if (bMixedInputs && InputBelt.Num() > 0)
     {
-        TSubclassOf<AFGBuildableManufacturer> ManClass =
-            Cache->GetBuildableClass<AFGBuildableManufacturer>(MachineType);
-        AFGBuildableManufacturer* Man = World->SpawnActor<AFGBuildableManufacturer>(ManClass, Transform);
-        if (Recipe.IsSet())
+        int32 Previous = INDEX_NONE;
+        for (int32 k = 0; k < InputBelt.Num(); ++k)
         {
-            TSubclassOf<UFGRecipe> RecipeClass = Cache->GetRecipeClass(Recipe.GetValue(), ManClass, World);
-            if (RecipeClass)
-            {
-                if (Underclock.IsSet() && RCO && Player)
-                {
-                    RCO->Server_PasteSettings(Man, Player, RecipeClass, Underclock.GetValue() / 100.0f, 1.0f, nullptr,
-                                              nullptr);
-                }
-                else
-                {
-                    Man->SetRecipe(RecipeClass);
-                }
-            }
+            const int32 Splitter =
+                Cell.Buildables.Add({EBuildable::SmartSplitter, GetMixedBeltLane(InputBelt[k]), false, k});
+            Cell.Links.Add({EPlannedLink::Belt, {Splitter, SmartSplitterMachinePort}, {0, InputBelt[k].Index}});
+            if (Previous == INDEX_NONE)
+                Cell.Manifolds.Add({EPlannedLink::Belt, {Splitter, SmartSplitterPassPort}, {Splitter, 1}});
+            else
+                Cell.Links.Add({EPlannedLink::Belt, {Previous, SmartSplitterPassPort}, {Splitter, 1}});
+            Previous = Splitter;
         }
-        Spawned = Man;
+        Cell.Manifolds.Last().Open = {Previous, SmartSplitterPassPort};
+        InputBelt.Reset();
     }
 
-    BuildablesForBlueprint.Add(Spawned);
+    for (const FConnector& Conn : InputBelt)
+    {
+        const int32 Splitter = Cell.Buildables.Add({EBuildable::Splitter, GetInputBeltLane(Conn)});
+        Cell.Manifolds.Add({EPlannedLink::Belt, {Splitter, 0}, {Splitter, 1}});
+        Cell.Links.Add({EPlannedLink::Belt, {Splitter, 3}, {0, Conn.Index}});
+    }
 
-    TArray<UFGPowerConnectionComponent*> PowerConns = GetConnections<UFGPowerConnectionComponent>(Spawned);
-    outPowerConn = PowerConns[0];
-    outBeltConn = GetConnections<UFGFactoryConnectionComponent>(Spawned);
-    outPipeConn = GetConnections<UFGPipeConnectionComponent>(Spawned);
-}
+    for (const FConnector& Conn : OutputBelt)
+    {
+        const int32 Merger = Cell.Buildables.Add({EBuildable::Merger, GetOutputBeltLane(Conn), true});
+        Cell.Manifolds.Add({EPlannedLink::Belt, {Merger, 0}, {Merger, 1}, true});
+        Cell.Links.Add(
+            {EPlannedLink::Belt, {0, Conn.Index}, {Merger, MachineType == EBuildable::NuclearReactor ? 3 : 2}});
+    }
 
-TArray<UFGFactoryConnectionComponent*> FBuildPlanGenerator::SpawnSplitterOrMerger(const FVector& Location,
-                                                                                  EBuildable SplitterOrMerger)
-{
-    const bool bFlip = SplitterOrMerger == EBuildable::Merger;
-    TSubclassOf<AFGBuildable> Class = Cache->GetBuildableClass<AFGBuildable>(SplitterOrMerger);
-    const FTransform UnitTransform = MoveTransform(Location, bFlip);
-    AFGBuildable* Spawned = World->SpawnActor<AFGBuildable>(Class, UnitTransform);
-    BuildablesForBlueprint.Add(Spawned);
-    return GetConnections<UFGFactoryConnectionComponent>(Spawned);
+    for (const FConnector& Conn : InputPipe)
+    {
+        const int32 Cross = Cell.Buildables.Add({EBuildable::PipeCross, GetInputPipeLane(Conn)});
+        Cell.Manifolds.Add({EPlannedLink::Pipe, {Cross, 0}, {Cross, 3}});
+        Cell.Links.Add({EPlannedLink::Pipe, {0, Conn.Index}, {Cross, 1}});
+    }
+
+    for (const FConnector& Conn : OutputPipe)
+    {
+        const int32 Cross = Cell.Buildables.Add({EBuildable::PipeCross, GetOutputPipeLane(Conn)});
+        Cell.Manifolds.Add({EPlannedLink::Pipe, {Cross, 0}, {Cross, 3}});
+        Cell.Links.Add({EPlannedLink::Pipe, {0, Conn.Index}, {Cross, 2}});
+    }
+
+    return Cell;
 }
 
-void FBuildPlanGenerator::SpawnLiftOrBeltAndConnect(UFGFactoryConnectionComponent* From,
-                                                    UFGFactoryConnectionComponent* To)
+void FBuildPlanGenerator::StampMachineCell(const FMachineCell& Cell, int32 Recipe, int32 MachineClass,
+                                           float ClockPercent, float ProductionBoost, EPowerScheme PowerScheme,
+                                           int32 RowIndex, bool bFirstUnitInRow, TConstArrayView<int32> FilterItems)
 {
-    FVector FromLoc = From->GetComponentLocation();
-    FVector ToLoc = To->GetComponentLocation();
-    FVector ConnDistance = FromLoc - ToLoc;
+    const FVector Origin(XCursor, YCursor, 0);
+    const int32 First = Plan.Buildables.Num();
+    for (const FMachineCell::FCellBuildable& Buildable : Cell.Buildables)
+    {
+        const int32 Index = Plan.AddBuildable(Buildable.Type, Origin + Buildable.Offset, Buildable.bFlipped, RowIndex);
+        if (FilterItems.IsValidIndex(Buildable.Filter))
+            Plan.Buildables[Index].ClassPath = FilterItems[Buildable.Filter];
+    }
 
-    // Calculate absolute component distances
-    const float DZ = FMath::Abs(ConnDistance.Z);
-    const float DX = FMath::Abs(ConnDistance.X);
-    const float DY = FMath::Abs(ConnDistance.Y);
+    FPlannedBuildable& Machine = Plan.Buildables[First];
+    Machine.ClassPath = Recipe;
+    Machine.MachineClass = (int16) MachineClass;
+    Machine.ClockPercent = ClockPercent;
+    Machine.ProductionBoost = ProductionBoost;
 
-    // Quantum encoder has an input port that is further away and we need a belt instead of a lift
-    // Lift needs some height difference and not too far apart horizontally
-    const float MinVerticalForLift = 400.0f;
-    const float MaxHorizontalForLift = 600.0f;
+    ConnectMachinePower(First, Origin + Cell.PoleAnchor, PowerScheme, RowIndex, bFirstUnitInRow);
 
-    const bool bUseLift = (DZ >= MinVerticalForLift) && (DX <= MaxHorizontalForLift) && (DY <= MaxHorizontalForLift);
+    auto ToPlan = [First](const FPlanPort& Port) { return FPlanPort{First + Port.Buildable, Port.Port}; };
+    auto GetTier = [this](EPlannedLink Type) { return Type == EPlannedLink::Pipe ? RowPipelineTier : RowBeltTier; };
 
-    if (bUseLift)
+    for (int32 i = 0; i < Cell.Manifolds.Num(); ++i)
     {
-        SpawnLiftAndConnect(From, To);
-    }
-    else
-    {
-        SpawnBeltAndConnect(From, To);
+        const FMachineCell::FManifold& Manifold = Cell.Manifolds[i];
+        if (!bFirstUnitInRow)
+        {
+            if (Manifold.bTowardsPrevious)
+                Plan.Connect(Manifold.Type, ToPlan(Manifold.Entry), ManifoldEnds[i], GetTier(Manifold.Type));
+            else
+                Plan.Connect(Manifold.Type, ManifoldEnds[i], ToPlan(Manifold.Entry), GetTier(Manifold.Type));
+        }
+        ManifoldEnds[i] = ToPlan(Manifold.Open);
     }
-}
 
-void FBuildPlanGenerator::SpawnBeltAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To)
-{
-    TSubclassOf<AFGBuildableConveyorBelt> BeltClass =
-        Cache->GetBuildableClass<AFGBuildableConveyorBelt>(EBuildable::Belt);
-    AFGBuildableConveyorBelt* Belt =
-        Cast<AFGBuildableConveyorBelt>(UFGTestBlueprintFunctionLibrary::SpawnSplineBuildable(BeltClass, From, To));
-
-    FVector FromLoc = From->GetComponentLocation();
-    FVector ToLoc = To->GetComponentLocation();
-    FVector TangentWorld = From->GetConnectorNormal() * FVector::Distance(FromLoc, ToLoc) * 1.5f;
-    FTransform BeltTransform = Belt->GetActorTransform();
-
-    TArray<FSplinePointData> SplinePoints;
-    SplinePoints.Add(FSplinePointData(BeltTransform.InverseTransformPosition(FromLoc),
-                                      BeltTransform.InverseTransformVectorNoScale(TangentWorld)));
-    SplinePoints.Add(FSplinePointData(BeltTransform.InverseTransformPosition(ToLoc),
-                                      BeltTransform.InverseTransformVectorNoScale(TangentWorld)));
-
-    BuildablesForBlueprint.Add(AFGBuildableConveyorBelt::Respline(Belt, SplinePoints));
+    for (const FMachineCell::FCellLink& Link : Cell.Links)
+        Plan.Connect(Link.Type, ToPlan(Link.From), ToPlan(Link.To), GetTier(Link.Type));
 }
 
-void FBuildPlanGenerator::SpawnLiftAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To)
+void FBuildPlanGenerator::ConnectMachinePower(int32 Machine, const FVector& PoleAnchor, EPowerScheme PowerScheme,
+                                              int32 RowIndex, bool bFirstUnitInRow)
 {
-    TSubclassOf<AFGBuildableConveyorLift> LiftClass =
-        Cache->GetBuildableClass<AFGBuildableConveyorLift>(EBuildable::Lift);
+    // Poles are planned once all machines are known, see PlanPowerNetwork
+    if (PowerScheme == EPowerScheme::Poles)
+    {
+        PowerConsumers.Add({Machine, PoleAnchor, RowIndex});
+        return;
+    }
+
+    // Daisy-chained rows: only the head of the row needs a pole or outlet
+    if (!bFirstUnitInRow && LastMachine != INDEX_NONE)
+        Plan.Connect(EPlannedLink::PowerLine, {LastMachine}, {Machine});
+    else if (PowerScheme == EPowerScheme::WallOutlets)
+        PowerConsumers.Add({Machine, PoleAnchor + FVector(-WallGap - WallThickness, WallWidth / 2, WallOutletHeight),
+                            RowIndex, true});
+    else
+        PowerConsumers.Add({Machine, PoleAnchor, FPowerPlanner::SharedGroup});
 
-    // Get the connection locations
-    FVector FromLoc = From->GetComponentLocation();
-    FVector ToLoc = To->GetComponentLocation();
+    LastMachine = Machine;
+}
 
-    FTransform InputTransform(FRotator(0, 270, 0), FromLoc + FVector(0, 300, 0));
+void FBuildPlanGenerator::PlanPowerNetwork()
+{
+    FMemMark Mark(FMemStack::Get());
+    TArray<FPowerSite, TMemStackAllocator<>> Sites;
+    Sites.Reserve(PowerConsumers.Num());
+    for (const FPowerConsumer& Consumer : PowerConsumers)
+        Sites.Add({Consumer.PoleAnchor, Consumer.Group, Consumer.bWallMount});
 
-    AFGBuildableConveyorLift* Lift = World->SpawnActor<AFGBuildableConveyorLift>(LiftClass, InputTransform);
+    const FPowerNetworkPlan PowerPlan = FPowerPlanner::Plan(Sites, Cache->GetMaxPowerPoleTier());
 
-    // Calculate the top transform relative to the lift's base
-    FVector OutputHeightOffset(0, 0, ToLoc.Z - FromLoc.Z);
-    FTransform TopTransform(FRotator(0.0f, 180.0f, 0.0f), OutputHeightOffset);
+    auto GetRow = [&](int32 Site) { return Plan.Buildables[PowerConsumers[Site].Machine].Row; };
 
-    // Use Unreal's reflection system to set the private mTopTransform property
-    FProperty* TopTransformProp = Lift->GetClass()->FindPropertyByName(TEXT("mTopTransform"));
-    FStructProperty* StructProp = CastField<FStructProperty>(TopTransformProp);
-    if (StructProp && StructProp->Struct == TBaseStructure<FTransform>::Get())
+    TArray<int32, TMemStackAllocator<>> Poles;
+    Poles.Reserve(PowerPlan.Poles.Num());
+    for (const FPlannedPole& Pole : PowerPlan.Poles)
     {
-        void* PropertyAddress = StructProp->ContainerPtrToValuePtr<void>(Lift);
-        StructProp->CopyCompleteValue(PropertyAddress, &TopTransform);
-    }
+        EBuildable PoleType = EBuildable::PowerWallOutlet;
+        if (!Pole.bWallMount)
+            PoleType = Pole.Tier == 3   ? EBuildable::PowerPoleMk3
+                       : Pole.Tier == 2 ? EBuildable::PowerPoleMk2
+                                        : EBuildable::PowerPole;
+
+        // Poles shared by several rows belong to none
+        int32 Row = Pole.Sites.Num() > 0 ? GetRow(Pole.Sites[0]) : INDEX_NONE;
+        for (int32 Site : Pole.Sites)
+        {
+            if (GetRow(Site) != Row)
+                Row = INDEX_NONE;
+        }
 
-    TArray<UFGFactoryConnectionComponent*> LiftConnections = GetConnections<UFGFactoryConnectionComponent>(Lift);
-    From->SetConnection(LiftConnections[0]);
-    LiftConnections[1]->SetConnection(To);
-    Lift->SetupConnections();
+        // The wall spans the side of the first machine, so the belts of the row pass it
+        if (Pole.bWallMount)
+            Plan.AddBuildable(EBuildable::Wall, Pole.Location + FVector(WallThickness / 2, 0, -WallOutletHeight),
+                              false, Row);
 
-    BuildablesForBlueprint.Add(Lift);
-}
+        const int32 PoleIndex = Plan.AddBuildable(PoleType, Pole.Location, Pole.bWallMount, Row);
+        for (int32 Site : Pole.Sites)
+            Plan.Connect(EPlannedLink::PowerLine, {PoleIndex}, {PowerConsumers[Site].Machine});
+        Poles.Add(PoleIndex);
+    }
 
-TArray<UFGPipeConnectionComponent*> FBuildPlanGenerator::SpawnPipeCross(const FVector& Location)
-{
-    TSubclassOf<AFGBuildable> Class = Cache->GetBuildableClass<AFGBuildable>(EBuildable::PipeCross);
-    const FTransform UnitTransform = MoveTransform(Location);
-    AFGBuildable* Spawned = World->SpawnActor<AFGBuildable>(Class, UnitTransform);
-    BuildablesForBlueprint.Add(Spawned);
-    return GetConnections<UFGPipeConnectionComponent>(Spawned);
+    for (const TPair<int32, int32>& Link : PowerPlan.PoleLinks)
+        Plan.Connect(EPlannedLink::PowerLine, {Poles[Link.Key]}, {Poles[Link.Value]});
 }
-
-void FBuildPlanGenerator::SpawnPipeAndConnect(UFGPipeConnectionComponent* From, UFGPipeConnectionComponent* To)
-{
-    TSubclassOf<AFGBuildablePipeline> PipeClass = Cache->GetBuildableClass<AFGBuildablePipeline>(EBuildable::Pipeline);
-    AFGBuildable* Spawned = UFGTestBlueprintFunctionLibrary::SpawnSplineBuildable(PipeClass, From, To);
-    BuildablesForBlueprint.Add(Spawned);
-}
\ No newline at end of file
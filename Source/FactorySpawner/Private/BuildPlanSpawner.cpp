@@ -0,0 +1,501 @@
+#include "BuildPlanSpawner.h"
+#include "BuildableCache.h"
+#include "FactorySpawner.h"
+#include "FGBlueprintSubsystem.h"
+#include "FGLightweightBuildableSubsystem.h"
+#include "Buildables/FGBuildableManufacturer.h"
+#include "Tests/FGTestBlueprintFunctionLibrary.h"
+#include "FGPlayerController.h"
+#include "FGCharacterPlayer.h"
+#include "FGPowerConnectionComponent.h"
+#include "Buildables/FGBuildableWire.h"
+#include "Buildables/FGBuildablePowerPole.h"
+#include "FGFactoryConnectionComponent.h"
+#include "Buildables/FGBuildableConveyorBelt.h"
+#include "Buildables/FGBuildableConveyorLift.h"
+#include "Buildables/FGBuildablePipeline.h"
+#include "Buildables/FGBuildableSplitterSmart.h"
+#include "FGPipeConnectionComponent.h"
+#include "FGRecipe.h"
+#include "Resources/FGItemDescriptor.h"
+#include "Resources/FGOverflowDescriptor.h"
+#include "Resources/FGAnyUndefinedDescriptor.h"
+
+namespace
+{
+    const FQuat Rot180 = FQuat(FVector::UpVector, PI);
+
+    FTransform MoveTransform(const FTransform& Base, const FVector& Offset, bool bFlip = false)
+    {
+        const FVector NewLoc = Base.TransformPosition(Offset);
+        const FQuat NewRot = bFlip ? Rot180 * Base.GetRotation() : Base.GetRotation();
+        return FTransform(NewRot, NewLoc);
+    }
+
+    template <typename T> T* GetConnection(AFGBuildable* Buildable, int32 Port)
+    {
+        TInlineComponentArray<T*> Connections(Buildable);
+        return Connections.IsValidIndex(Port) ? Connections[Port] : nullptr;
+    }
+
+    UFGPowerConnectionComponent* GetPowerConnection(AFGBuildable* Buildable)
+    {
+        if (AFGBuildablePowerPole* Pole = Cast<AFGBuildablePowerPole>(Buildable))
+            return Pole->GetPowerConnection(0);
+        return GetConnection<UFGPowerConnectionComponent>(Buildable, 0);
+    }
+
+    // Index of a port among the outputs of an attachment, as sort rules count them
+    int32 GetOutputIndex(AFGBuildable* Buildable, int32 Port)
+    {
+        TInlineComponentArray<UFGFactoryConnectionComponent*> Connections(Buildable);
+        int32 OutputIndex = 0;
+        for (int32 i = 0; i < Port && i < Connections.Num(); ++i)
+        {
+            if (Connections[i]->GetDirection() == EFactoryConnectionDirection::FCD_OUTPUT)
+                ++OutputIndex;
+        }
+        return OutputIndex;
+    }
+
+    // Spawn calls between two deadline checks
+    constexpr int32 StepBatchSize = 16;
+} // namespace
+
+FBuildPlanSpawner::FBuildPlanSpawner(UWorld* InWorld, UBuildableCache* InCache, AFGPlayerController* Instigator,
+                                     const FString& InBlueprintName)
+{
+    World = InWorld;
+    Cache = InCache;
+    BlueprintName = InBlueprintName;
+
+    AFGPlayerController* PC = Instigator ? Instigator : Cast<AFGPlayerController>(World->GetFirstPlayerController());
+    if (PC)
+    {
+        Player = Cast<AFGCharacterPlayer>(PC->GetCharacter());
+        RCO = PC->GetRemoteCallObjectOfClass<UFGManufacturerClipboardRCO>();
+    }
+}
+
+void FBuildPlanSpawner::Begin(const TSharedRef<const FSharedBuildPlan>& InPlan)
+{
+    SharedPlan = InPlan;
+    Plan = InPlan->GetView();
+    NextBuildable = NextConnection = 0;
+    Timings = FTimings();
+
+    // Other commands may change the cache's tiers while this plan is still spawning
+    BeltClasses[0] = Cache->GetTieredClass(EBuildable::Belt, Cache->GetBeltTier());
+    LiftClasses[0] = Cache->GetTieredClass(EBuildable::Lift, Cache->GetBeltTier());
+    PipeClasses[0] = Cache->GetTieredClass(EBuildable::Pipeline, Cache->GetPipelineTier());
+    for (int32 Tier = 1; Tier < UE_ARRAY_COUNT(BeltClasses); ++Tier)
+        BeltClasses[Tier] = LiftClasses[Tier] = nullptr;
+    for (int32 Tier = 1; Tier < UE_ARRAY_COUNT(PipeClasses); ++Tier)
+        PipeClasses[Tier] = nullptr;
+    for (const FPlannedConnection& Connection : Plan.Connections)
+    {
+        const int32 Tier = Connection.Tier;
+        if (Connection.Type == EPlannedLink::Belt && Tier < UE_ARRAY_COUNT(BeltClasses) && !BeltClasses[Tier])
+        {
+            BeltClasses[Tier] = Cache->GetTieredClass(EBuildable::Belt, Tier);
+            LiftClasses[Tier] = Cache->GetTieredClass(EBuildable::Lift, Tier);
+        }
+        else if (Connection.Type == EPlannedLink::Pipe && Tier < UE_ARRAY_COUNT(PipeClasses) && !PipeClasses[Tier])
+        {
+            PipeClasses[Tier] = Cache->GetTieredClass(EBuildable::Pipeline, Tier);
+        }
+    }
+
+    // Recipes and filter items are stored by class path, no lookup through the recipe manager
+    RecipeClasses.Reset(Plan.ClassPaths.Num());
+    ItemClasses.Reset(Plan.ClassPaths.Num());
+    for (const FString& ClassPath : Plan.ClassPaths)
+    {
+        UClass* Class = TSoftClassPtr<UObject>(FSoftObjectPath(ClassPath)).LoadSynchronous();
+        RecipeClasses.Add(Class && Class->IsChildOf<UFGRecipe>() ? Class : nullptr);
+        ItemClasses.Add(Class && Class->IsChildOf<UFGItemDescriptor>() ? Class : nullptr);
+    }
+
+    SpawnedBuildables.Reset(Plan.Buildables.Num());
+    BuildablesForBlueprint.Reset(Plan.Buildables.Num() + Plan.Connections.Num());
+    NumPooledBuildables = 0;
+}
+
+bool FBuildPlanSpawner::Step(double Deadline)
+{
+    const double StepStart = FPlatformTime::Seconds();
+    while (NextBuildable < Plan.Buildables.Num())
+    {
+        const int32 End = FMath::Min(NextBuildable + StepBatchSize, Plan.Buildables.Num());
+        for (; NextBuildable < End; ++NextBuildable)
+            SpawnedBuildables.Add(SpawnBuildable(Plan.Buildables[NextBuildable]));
+        NumPooledBuildables = BuildablesForBlueprint.Num();
+        const double Now = FPlatformTime::Seconds();
+        if (Now >= Deadline)
+        {
+            Timings.Spawn += Now - StepStart;
+            return false;
+        }
+    }
+
+    while (NextConnection < Plan.Connections.Num())
+    {
+        const int32 End = FMath::Min(NextConnection + StepBatchSize, Plan.Connections.Num());
+        for (; NextConnection < End; ++NextConnection)
+            SpawnConnection(Plan.Connections[NextConnection]);
+        const double Now = FPlatformTime::Seconds();
+        if (Now >= Deadline && NextConnection < Plan.Connections.Num())
+        {
+            Timings.Spawn += Now - StepStart;
+            return false;
+        }
+    }
+    Timings.Spawn += FPlatformTime::Seconds() - StepStart;
+
+    if (bPlaceInWorld)
+    {
+        // The buildables stay where they are, foundations as lightweight instances like the build gun places them
+        for (const TWeakObjectPtr<AFGBuildable>& Buildable : BuildablesForBlueprint)
+        {
+            if (Buildable.IsValid())
+                Buildable->Tags.Remove(UBuildableCache::UnsavedTag);
+        }
+        ConvertToLightweight();
+        BuildablesForBlueprint.Reset();
+        SpawnedBuildables.Reset();
+        NumPooledBuildables = 0;
+        return true;
+    }
+
+    WriteBlueprint();
+    DestroyBuildables();
+    return true;
+}
+
+void FBuildPlanSpawner::Spawn(const TSharedRef<const FSharedBuildPlan>& InPlan)
+{
+    Begin(InPlan);
+    Step(MAX_dbl);
+}
+
+void FBuildPlanSpawner::SetPlacement(const FTransform& InPlacement)
+{
+    Placement = InPlacement;
+    bPlaceInWorld = true;
+}
+
+void FBuildPlanSpawner::Cancel()
+{
+    DestroyBuildables();
+    NextBuildable = NextConnection = 0;
+}
+
+float FBuildPlanSpawner::GetProgress() const
+{
+    const int32 NumRecords = GetNumRecords();
+    return NumRecords > 0 ? (float) (NextBuildable + NextConnection) / NumRecords : 1.0f;
+}
+
+void FBuildPlanSpawner::AddSpawned(AFGBuildable* Buildable)
+{
+    // A blueprint may take several frames; nobody should see or bump into its buildables in the meantime
+    if (Buildable && !bPlaceInWorld)
+    {
+        Buildable->SetActorHiddenInGame(true);
+        Buildable->SetActorEnableCollision(false);
+    }
+    // A save in the middle of the job must not keep half a factory
+    if (Buildable)
+        Buildable->Tags.AddUnique(UBuildableCache::UnsavedTag);
+    BuildablesForBlueprint.Add(Buildable);
+}
+
+void FBuildPlanSpawner::WriteBlueprint()
+{
+    const double Start = FPlatformTime::Seconds();
+    AFGBlueprintSubsystem* BlueprintSubsystem = AFGBlueprintSubsystem::Get(World);
+    UFGBlueprintDescriptor* ExistingDescriptor =
+        BlueprintSubsystem->GetBlueprintDescriptorByNameString(BlueprintName);
+    if (ExistingDescriptor)
+        BlueprintSubsystem->DeleteBlueprintDescriptor(ExistingDescriptor);
+
+    FBlueprintRecord Record;
+    Record.BlueprintName = BlueprintName;
+    Record.BlueprintDescription = TEXT("Auto-generated blueprint");
+    Record.Color = FLinearColor::White;
+
+    TArray<AFGBuildable*> Buildables;
+    Buildables.Reserve(BuildablesForBlueprint.Num());
+    for (const TWeakObjectPtr<AFGBuildable>& Buildable : BuildablesForBlueprint)
+    {
+        if (Buildable.IsValid())
+            Buildables.Add(Buildable.Get());
+    }
+    BlueprintSubsystem->WriteBlueprintToArchive(Record, FTransform::Identity, Buildables, FIntVector(1, 1, 1));
+    BlueprintSubsystem->RefreshBlueprintsAndDescriptors();
+    Timings.Blueprint += FPlatformTime::Seconds() - Start;
+}
+
+void FBuildPlanSpawner::ConvertToLightweight()
+{
+    AFGLightweightBuildableSubsystem* Lightweights = AFGLightweightBuildableSubsystem::Get(World);
+    if (!Lightweights)
+        return;
+
+    // Blueprints keep the actors, the game converts them when the blueprint is built
+    for (int32 i = 0; i < SpawnedBuildables.Num(); ++i)
+    {
+        AFGBuildable* Buildable = SpawnedBuildables[i].Get();
+        if (!Buildable || !IsLightweight(Plan.Buildables[i].Type))
+            continue;
+        if (Lightweights->AddFromBuildable(Buildable) != INDEX_NONE)
+            Buildable->Destroy();
+    }
+}
+
+void FBuildPlanSpawner::DestroyBuildables()
+{
+    const double Start = FPlatformTime::Seconds();
+
+    // Splines and wires first, so they disconnect from the buildables that go back into the pool
+    // Buildables a player has dismantled meanwhile are gone already
+    for (int32 i = NumPooledBuildables; i < BuildablesForBlueprint.Num(); ++i)
+    {
+        if (AFGBuildable* Buildable = BuildablesForBlueprint[i].Get())
+            Buildable->Destroy();
+    }
+
+    for (int32 i = 0; i < NumPooledBuildables; ++i)
+    {
+        AFGBuildable* Buildable = BuildablesForBlueprint[i].Get();
+        if (Buildable && !Cache->ReleaseBuildable(Buildable))
+            Buildable->Destroy();
+    }
+    BuildablesForBlueprint.Reset();
+    NumPooledBuildables = 0;
+    SpawnedBuildables.Reset();
+    Timings.Destroy += FPlatformTime::Seconds() - Start;
+}
+
+AFGBuildable* FBuildPlanSpawner::SpawnBuildable(const FPlannedBuildable& Buildable)
+{
+    const FTransform Transform = MoveTransform(Placement, FVector(Buildable.Location), Buildable.bFlipped != 0);
+
+    AFGBuildable* Spawned = nullptr;
+    if (Buildable.Type <= EBuildable::CustomMachine)
+        Spawned = SpawnMachine(Buildable, Transform);
+    else if (IsGenerator(Buildable.Type))
+        Spawned = SpawnGenerator(Buildable, Transform);
+    else if (Buildable.Type == EBuildable::SmartSplitter)
+        Spawned = SpawnSmartSplitter(Buildable, Transform);
+    else
+        Spawned = Cache->AcquireBuildable(World, Cache->GetBuildableClass<AFGBuildable>(Buildable.Type), Transform);
+
+    if (Spawned && Buildable.Type < EBuildable::Splitter)
+        Cache->CheckPortOrder(Buildable.Type, Plan.GetMachineClassPath(Buildable), Spawned);
+    if (Spawned)
+        AddSpawned(Spawned);
+    return Spawned;
+}
+
+AFGBuildable* FBuildPlanSpawner::SpawnMachine(const FPlannedBuildable& Buildable, const FTransform& Transform)
+{
+    // A custom machine need not be a manufacturer, it is spawned all the same but gets no recipe
+    AFGBuildable* Spawned = Cache->AcquireBuildable(
+        World, Cache->GetMachineClass(Buildable.Type, Plan.GetMachineClassPath(Buildable)), Transform);
+    AFGBuildableManufacturer* Man = Cast<AFGBuildableManufacturer>(Spawned);
+
+    TSubclassOf<UFGRecipe> RecipeClass =
+        RecipeClasses.IsValidIndex(Buildable.ClassPath) ? RecipeClasses[Buildable.ClassPath] : nullptr;
+    if (!Man || !RecipeClass)
+        return Spawned;
+
+    const bool bClocked = !FMath::IsNearlyEqual(Buildable.ClockPercent, 100.0f) || Buildable.ProductionBoost > 1.0f;
+    if (bClocked && RCO && Player)
+    {
+        RCO->Server_PasteSettings(Man, Player, RecipeClass, Buildable.ClockPercent / 100.0f,
+                                  Buildable.ProductionBoost, nullptr, nullptr);
+    }
+    else
+    {
+        Man->SetRecipe(RecipeClass);
+    }
+    return Man;
+}
+
+AFGBuildable* FBuildPlanSpawner::SpawnGenerator(const FPlannedBuildable& Buildable, const FTransform& Transform)
+{
+    AFGBuildableFactory* Generator = Cast<AFGBuildableFactory>(
+        Cache->AcquireBuildable(World, Cache->GetBuildableClass<AFGBuildable>(Buildable.Type), Transform));
+
+    // Fuel, water and power of the row were planned at this clock; pooled generators come back at 100%
+    if (Generator && !FMath::IsNearlyEqual(Buildable.ClockPercent, 100.0f))
+        Generator->SetPendingPotential(Buildable.ClockPercent / 100.0f);
+    return Generator;
+}
+
+AFGBuildable* FBuildPlanSpawner::SpawnSmartSplitter(const FPlannedBuildable& Buildable, const FTransform& Transform)
+{
+    AFGBuildableSplitterSmart* Splitter = Cast<AFGBuildableSplitterSmart>(
+        Cache->AcquireBuildable(World, Cache->GetBuildableClass<AFGBuildable>(Buildable.Type), Transform));
+
+    if (!Splitter)
+        return nullptr;
+
+    // A pooled splitter still has the rules of its last command
+    while (Splitter->GetNumSortRules() > 0)
+        Splitter->RemoveSortRuleAt(0);
+
+    TSubclassOf<UFGItemDescriptor> Item =
+        ItemClasses.IsValidIndex(Buildable.ClassPath) ? ItemClasses[Buildable.ClassPath] : nullptr;
+    if (!Item)
+        return Splitter;
+
+    // The filter item goes to the machine; everything else, and the filter item once the machine is full, passes on
+    FSplitterSortRule ToMachine;
+    ToMachine.ItemClass = Item;
+    ToMachine.OutputIndex = GetOutputIndex(Splitter, SmartSplitterMachinePort);
+    Splitter->AddSortRule(ToMachine);
+
+    FSplitterSortRule PassOn;
+    PassOn.ItemClass = UFGAnyUndefinedDescriptor::StaticClass();
+    PassOn.OutputIndex = GetOutputIndex(Splitter, SmartSplitterPassPort);
+    Splitter->AddSortRule(PassOn);
+
+    FSplitterSortRule Overflow;
+    Overflow.ItemClass = UFGOverflowDescriptor::StaticClass();
+    Overflow.OutputIndex = PassOn.OutputIndex;
+    Splitter->AddSortRule(Overflow);
+    return Splitter;
+}
+
+void FBuildPlanSpawner::SpawnConnection(const FPlannedConnection& Connection)
+{
+    // Either end may have failed to spawn or been dismantled since
+    AFGBuildable* From = SpawnedBuildables[Connection.From].Get();
+    AFGBuildable* To = SpawnedBuildables[Connection.To].Get();
+    if (!From || !To)
+        return;
+
+    switch (Connection.Type)
+    {
+    case EPlannedLink::Belt:
+    {
+        UFGFactoryConnectionComponent* FromConn =
+            GetConnection<UFGFactoryConnectionComponent>(From, Connection.FromPort);
+        UFGFactoryConnectionComponent* ToConn = GetConnection<UFGFactoryConnectionComponent>(To, Connection.ToPort);
+        if (FromConn && ToConn)
+            SpawnLiftOrBeltAndConnect(FromConn, ToConn, Connection.Tier);
+        break;
+    }
+    case EPlannedLink::Pipe:
+    {
+        UFGPipeConnectionComponent* FromConn = GetConnection<UFGPipeConnectionComponent>(From, Connection.FromPort);
+        UFGPipeConnectionComponent* ToConn = GetConnection<UFGPipeConnectionComponent>(To, Connection.ToPort);
+        if (FromConn && ToConn)
+            SpawnPipeAndConnect(FromConn, ToConn, Connection.Tier);
+        break;
+    }
+    case EPlannedLink::PowerLine:
+    {
+        UFGPowerConnectionComponent* FromConn = GetPowerConnection(From);
+        UFGPowerConnectionComponent* ToConn = GetPowerConnection(To);
+        if (FromConn && ToConn)
+            SpawnWireAndConnect(FromConn, ToConn);
+        break;
+    }
+    }
+}
+
+void FBuildPlanSpawner::SpawnWireAndConnect(UFGPowerConnectionComponent* A, UFGPowerConnectionComponent* B)
+{
+    TSubclassOf<AFGBuildableWire> PowerLineClass = Cache->GetBuildableClass<AFGBuildableWire>(EBuildable::PowerLine);
+    AFGBuildableWire* Wire = World->SpawnActor<AFGBuildableWire>(PowerLineClass, FTransform::Identity);
+    Wire->Connect(A, B);
+    AddSpawned(static_cast<AFGBuildable*>(Wire));
+}
+
+void FBuildPlanSpawner::SpawnLiftOrBeltAndConnect(UFGFactoryConnectionComponent* From,
+                                                  UFGFactoryConnectionComponent* To, int32 Tier)
+{
+    // Quantum encoder has an input port that is further away and we need a belt instead of a lift
+    const bool bUseLift = ShouldUseLift(Placement.InverseTransformPosition(From->GetComponentLocation()),
+                                        Placement.InverseTransformPosition(To->GetComponentLocation()));
+
+    if (bUseLift)
+    {
+        SpawnLiftAndConnect(From, To, Tier);
+    }
+    else
+    {
+        SpawnBeltAndConnect(From, To, Tier);
+    }
+}
+
+void FBuildPlanSpawner::SpawnBeltAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To,
+                                            int32 Tier)
+{
+    TSubclassOf<AFGBuildableConveyorBelt> BeltClass =
+        *BeltClasses[Tier < UE_ARRAY_COUNT(BeltClasses) && BeltClasses[Tier] ? Tier : 0];
+    AFGBuildableConveyorBelt* Belt =
+        Cast<AFGBuildableConveyorBelt>(UFGTestBlueprintFunctionLibrary::SpawnSplineBuildable(BeltClass, From, To));
+
+    FVector FromLoc = From->GetComponentLocation();
+    FVector ToLoc = To->GetComponentLocation();
+    FVector TangentWorld = From->GetConnectorNormal() * FVector::Distance(FromLoc, ToLoc) * 1.5f;
+    FTransform BeltTransform = Belt->GetActorTransform();
+
+    TArray<FSplinePointData> SplinePoints;
+    SplinePoints.Add(FSplinePointData(BeltTransform.InverseTransformPosition(FromLoc),
+                                      BeltTransform.InverseTransformVectorNoScale(TangentWorld)));
+    SplinePoints.Add(FSplinePointData(BeltTransform.InverseTransformPosition(ToLoc),
+                                      BeltTransform.InverseTransformVectorNoScale(TangentWorld)));
+
+    AddSpawned(AFGBuildableConveyorBelt::Respline(Belt, SplinePoints));
+}
+
+void FBuildPlanSpawner::SpawnLiftAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To,
+                                            int32 Tier)
+{
+    TSubclassOf<AFGBuildableConveyorLift> LiftClass =
+        *LiftClasses[Tier < UE_ARRAY_COUNT(LiftClasses) && LiftClasses[Tier] ? Tier : 0];
+
+    // Get the connection locations
+    FVector FromLoc = From->GetComponentLocation();
+    FVector ToLoc = To->GetComponentLocation();
+
+    // The offset and rotation are in plan space
+    const FTransform InputTransform =
+        FTransform(FRotator(0, 270, 0), Placement.InverseTransformPosition(FromLoc) + FVector(0, 300, 0)) * Placement;
+
+    AFGBuildableConveyorLift* Lift = World->SpawnActor<AFGBuildableConveyorLift>(LiftClass, InputTransform);
+
+    // Calculate the top transform relative to the lift's base
+    FVector OutputHeightOffset(0, 0, ToLoc.Z - FromLoc.Z);
+    FTransform TopTransform(FRotator(0.0f, 180.0f, 0.0f), OutputHeightOffset);
+
+    // Use Unreal's reflection system to set the private mTopTransform property
+    FProperty* TopTransformProp = Lift->GetClass()->FindPropertyByName(TEXT("mTopTransform"));
+    FStructProperty* StructProp = CastField<FStructProperty>(TopTransformProp);
+    if (StructProp && StructProp->Struct == TBaseStructure<FTransform>::Get())
+    {
+        void* PropertyAddress = StructProp->ContainerPtrToValuePtr<void>(Lift);
+        StructProp->CopyCompleteValue(PropertyAddress, &TopTransform);
+    }
+
+    TInlineComponentArray<UFGFactoryConnectionComponent*> LiftConnections(Lift);
+    From->SetConnection(LiftConnections[0]);
+    LiftConnections[1]->SetConnection(To);
+    Lift->SetupConnections();
+
+    AddSpawned(Lift);
+}
+
+void FBuildPlanSpawner::SpawnPipeAndConnect(UFGPipeConnectionComponent* From, UFGPipeConnectionComponent* To,
+                                            int32 Tier)
+{
+    TSubclassOf<AFGBuildablePipeline> PipeClass =
+        *PipeClasses[Tier < UE_ARRAY_COUNT(PipeClasses) && PipeClasses[Tier] ? Tier : 0];
+    AFGBuildable* Spawned = UFGTestBlueprintFunctionLibrary::SpawnSplineBuildable(PipeClass, From, To);
+    AddSpawned(Spawned);
+}
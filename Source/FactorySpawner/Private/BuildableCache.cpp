@@ -1,15 +1,28 @@
 #include "BuildableCache.h"
+#include "BuildPlanGenerator.h"
+#include "GeneratorFuel.h"
+#include "FGRecipe.h"
 #include "FGRecipeManager.h"
+#include "Resources/FGBuildingDescriptor.h"
 #include "Buildables/FGBuildableConveyorBelt.h"
 #include "Buildables/FGBuildableConveyorLift.h"
 #include "Buildables/FGBuildablePipeline.h"
 #include "UObject/SoftObjectPtr.h"
 #include "Buildables/FGBuildableManufacturer.h"
+#include "FGFactoryConnectionComponent.h"
+#include "FGPipeConnectionComponent.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "Engine/SCS_Node.h"
+#include "Engine/SimpleConstructionScript.h"
 #include "FactorySpawner.h"
 #include "FactorySpawnerChat.h"
+#include "RecipeIndex.h"
 
 namespace
 {
+    // Upper bound of hidden buildables kept per class
+    constexpr int32 MaxPooledPerClass = 256;
+
     // Helper: get enum name as string
     FString GetEnumName(EBuildable Value)
     {
@@ -35,6 +48,111 @@ namespace
         return Result;
     }
 
+    /**
+     * Calculate the variant index based on port requirements.
+     * The variants are ordered by pipe count (descending), then belt count (descending).
+     *
+     * @param MaxBelt Maximum available belt ports
+     * @param MaxPipe Maximum available pipe ports
+     * @param NeededBelt Required belt ports for the recipe
+     * @param NeededPipe Required pipe ports for the recipe
+     * @return The index of the variant in the configuration array
+     *
+     * Example: MaxBelt=2, MaxPipe=2
+     *   Index 0: (2 pipe, 2 belt)
+     *   Index 1: (2 pipe, 1 belt)
+     *   Index 2: (2 pipe, 0 belt)
+     *   Index 3: (1 pipe, 2 belt)
+     *   Index 4: (1 pipe, 1 belt)
+     *   Index 5: (1 pipe, 0 belt)
+     */
+    int32 GetPortVariantIndex(int32 MaxBelt, int32 MaxPipe, int32 NeededBelt, int32 NeededPipe)
+    {
+        const int32 NumBeltVariants = MaxBelt + 1;
+        const int32 BeltOffset = MaxBelt - NeededBelt;
+        const int32 PipeOffset = MaxPipe - NeededPipe;
+        return PipeOffset * NumBeltVariants + BeltOffset;
+    }
+
+    // Per-minute rates of a recipe's items at 100%, fluids converted from liters to m³
+    void GetItemRates(const TArray<FItemAmount>& Items, float Duration, TArray<FRecipeItemRate>& OutRates,
+                      int32& OutSolid, int32& OutFluid)
+    {
+        for (const FItemAmount& Item : Items)
+        {
+            FRecipeItemRate& Rate = OutRates.AddDefaulted_GetRef();
+            Rate.Item = Item.ItemClass;
+            Rate.bFluid = UFGItemDescriptor::GetForm(Item.ItemClass) != EResourceForm::RF_SOLID;
+            Rate.PerMinute = Duration > 0.0f ? Item.Amount * 60.0f / Duration : 0.0f;
+            if (Rate.bFluid)
+                Rate.PerMinute /= 1000.0f;
+            Rate.bFluid ? ++OutFluid : ++OutSolid;
+        }
+    }
+
+    /**
+     * Components of type T that an instance of Class gets, with their transform relative to the actor, in the order
+     * an instance lists them: native components first, then those of the construction scripts from the base
+     * blueprint on. Reads the class defaults and component templates, nothing is spawned.
+     */
+    template <typename T> TArray<TPair<const T*, FTransform>> GetTemplateComponents(UClass* Class)
+    {
+        TArray<TPair<const T*, FTransform>> Components;
+        const AActor* Defaults = Class->GetDefaultObject<AActor>();
+
+        auto GetNativeTransform = [](const USceneComponent* Component)
+        {
+            FTransform Transform = FTransform::Identity;
+            for (; Component; Component = Component->GetAttachParent())
+                Transform = Transform * Component->GetRelativeTransform();
+            return Transform;
+        };
+
+        TInlineComponentArray<USceneComponent*> NativeComponents(Defaults);
+        for (const USceneComponent* Component : NativeComponents)
+        {
+            if (const T* Typed = Cast<T>(Component))
+                Components.Add({Typed, GetNativeTransform(Component)});
+        }
+
+        TArray<UBlueprintGeneratedClass*, TInlineAllocator<4>> Blueprints;
+        for (UClass* Current = Class; Current; Current = Current->GetSuperClass())
+        {
+            if (UBlueprintGeneratedClass* Blueprint = Cast<UBlueprintGeneratedClass>(Current))
+                Blueprints.Insert(Blueprint, 0);
+        }
+
+        TFunction<void(const USCS_Node*, const FTransform&)> Visit =
+            [&](const USCS_Node* Node, const FTransform& ParentTransform)
+        {
+            FTransform Transform = ParentTransform;
+            if (const USceneComponent* Scene = Cast<USceneComponent>(Node->ComponentTemplate))
+                Transform = Scene->GetRelativeTransform() * ParentTransform;
+            if (const T* Typed = Cast<T>(Node->ComponentTemplate))
+                Components.Add({Typed, Transform});
+            for (const USCS_Node* Child : Node->GetChildNodes())
+                Visit(Child, Transform);
+        };
+
+        for (const UBlueprintGeneratedClass* Blueprint : Blueprints)
+        {
+            if (!Blueprint->SimpleConstructionScript)
+                continue;
+            for (const USCS_Node* Root : Blueprint->SimpleConstructionScript->GetRootNodes())
+            {
+                // Roots may hang below a native component
+                FTransform ParentTransform = FTransform::Identity;
+                for (const USceneComponent* Component : NativeComponents)
+                {
+                    if (Root->bIsParentComponentNative && Component->GetFName() == Root->ParentComponentOrVariableName)
+                        ParentTransform = GetNativeTransform(Component);
+                }
+                Visit(Root, ParentTransform);
+            }
+        }
+        return Components;
+    }
+
     // Generic soft class loader
     template <typename T> TSubclassOf<T> LoadClassSoft(const FString& Path, EBuildable Type)
     {
@@ -45,15 +163,52 @@ namespace
         return Loaded;
     }
 
+    // Same size and, in the variant with the most ports, the same ports at the same offsets. Lane levels are
+    // left out, the hand-made layouts order them by hand
+    bool IsSameLayout(const FMachineConfig& HandMade, const FMachineConfig& Derived)
+    {
+        auto GetPorts = [](const TArray<FMachineConnections>& Variants)
+        {
+            TArray<FIntPoint> Ports;
+            if (Variants.Num() > 0)
+            {
+                for (const FConnector& Conn : Variants[0].Belt)
+                    Ports.Add(FIntPoint(Conn.Index, Conn.LocationX));
+                for (const FConnector& Conn : Variants[0].Pipe)
+                    Ports.Add(FIntPoint(-1 - Conn.Index, Conn.LocationX));
+            }
+            Ports.Sort([](const FIntPoint& A, const FIntPoint& B) { return A.X < B.X; });
+            return Ports;
+        };
+        return HandMade.Width == Derived.Width && HandMade.Length == Derived.Length &&
+               GetPorts(HandMade.InputConnections) == GetPorts(Derived.InputConnections) &&
+               GetPorts(HandMade.OutputConnections) == GetPorts(Derived.OutputConnections);
+    }
+
     // Machine class paths table
     TMap<EBuildable, FString> MachineClassPaths = {
         {EBuildable::Splitter, "/Game/FactoryGame/Buildable/Factory/CA_Splitter/"
                                "Build_ConveyorAttachmentSplitter.Build_ConveyorAttachmentSplitter_C"},
         {EBuildable::Merger, "/Game/FactoryGame/Buildable/Factory/CA_Merger/"
                              "Build_ConveyorAttachmentMerger.Build_ConveyorAttachmentMerger_C"},
+        {EBuildable::SmartSplitter, "/Game/FactoryGame/Buildable/Factory/CA_SplitterSmart/"
+                                    "Build_ConveyorAttachmentSplitterSmart.Build_ConveyorAttachmentSplitterSmart_C"},
         {EBuildable::PowerPole,
          "/Game/FactoryGame/Buildable/Factory/PowerPoleMk1/Build_PowerPoleMk1.Build_PowerPoleMk1_C"},
+        {EBuildable::PowerPoleMk2,
+         "/Game/FactoryGame/Buildable/Factory/PowerPoleMk2/Build_PowerPoleMk2.Build_PowerPoleMk2_C"},
+        {EBuildable::PowerPoleMk3,
+         "/Game/FactoryGame/Buildable/Factory/PowerPoleMk3/Build_PowerPoleMk3.Build_PowerPoleMk3_C"},
+        {EBuildable::PowerWallOutlet,
+         "/Game/FactoryGame/Buildable/Factory/PowerPoleWall/Build_PowerPoleWall.Build_PowerPoleWall_C"},
         {EBuildable::PowerLine, "/Game/FactoryGame/Buildable/Factory/PowerLine/Build_PowerLine.Build_PowerLine_C"},
+        {EBuildable::Foundation1m,
+         "/Game/FactoryGame/Buildable/Building/Foundation/Build_Foundation_8x1_01.Build_Foundation_8x1_01_C"},
+        {EBuildable::Foundation2m,
+         "/Game/FactoryGame/Buildable/Building/Foundation/Build_Foundation_8x2_01.Build_Foundation_8x2_01_C"},
+        {EBuildable::Foundation4m,
+         "/Game/FactoryGame/Buildable/Building/Foundation/Build_Foundation_8x4_01.Build_Foundation_8x4_01_C"},
+        {EBuildable::Wall, "/Game/FactoryGame/Buildable/Building/Wall/Build_Wall_8x4_01.Build_Wall_8x4_01_C"},
         {EBuildable::PipeCross, "/Game/FactoryGame/Buildable/Factory/PipeJunction/"
                                 "Build_PipelineJunction_Cross.Build_PipelineJunction_Cross_C"},
         {EBuildable::OilRefinery,
@@ -78,6 +233,9 @@ namespace
 //-------------------------------------------------
 template <typename T> TSubclassOf<T> UBuildableCache::GetBuildableClass(EBuildable Type)
 {
+    // Has no class of its own, see GetMachineClass
+    if (Type == EBuildable::CustomMachine)
+        return nullptr;
     if (CachedClasses.Contains(Type))
         return Cast<UClass>(CachedClasses[Type]);
 
@@ -97,24 +255,48 @@ template <typename T> TSubclassOf<T> UBuildableCache::GetBuildableClass(EBuildab
 
 void UBuildableCache::SetBeltClass(int32 Tier)
 {
-    FString Path = FString::Printf(
-        TEXT("/Game/FactoryGame/Buildable/Factory/ConveyorBeltMk%d/Build_ConveyorBeltMk%d.Build_ConveyorBeltMk%d_C"),
-        Tier, Tier, Tier);
-    TSubclassOf<AFGBuildableConveyorBelt> LoadedClass = LoadClassSoft<AFGBuildableConveyorBelt>(Path, EBuildable::Belt);
+    TSubclassOf<AFGBuildable> LoadedClass = GetTieredClass(EBuildable::Belt, Tier);
     if (LoadedClass)
+    {
         CachedClasses.Add(EBuildable::Belt, LoadedClass);
+        BeltTier = Tier;
+    }
 }
 
 void UBuildableCache::SetLiftClass(int32 Tier)
 {
-    FString Path = FString::Printf(
-        TEXT("/Game/FactoryGame/Buildable/Factory/ConveyorLiftMk%d/Build_ConveyorLiftMk%d.Build_ConveyorLiftMk%d_C"),
-        Tier, Tier, Tier);
-    TSubclassOf<AFGBuildableConveyorLift> LoadedClass = LoadClassSoft<AFGBuildableConveyorLift>(Path, EBuildable::Lift);
+    TSubclassOf<AFGBuildable> LoadedClass = GetTieredClass(EBuildable::Lift, Tier);
     if (LoadedClass)
         CachedClasses.Add(EBuildable::Lift, LoadedClass);
 }
 
+TSubclassOf<AFGBuildable> UBuildableCache::GetTieredClass(EBuildable Type, int32 Tier)
+{
+    switch (Type)
+    {
+    case EBuildable::Belt:
+        return LoadClassSoft<AFGBuildableConveyorBelt>(
+            FString::Printf(TEXT("/Game/FactoryGame/Buildable/Factory/ConveyorBeltMk%d/"
+                                 "Build_ConveyorBeltMk%d.Build_ConveyorBeltMk%d_C"),
+                            Tier, Tier, Tier),
+            Type);
+    case EBuildable::Lift:
+        return LoadClassSoft<AFGBuildableConveyorLift>(
+            FString::Printf(TEXT("/Game/FactoryGame/Buildable/Factory/ConveyorLiftMk%d/"
+                                 "Build_ConveyorLiftMk%d.Build_ConveyorLiftMk%d_C"),
+                            Tier, Tier, Tier),
+            Type);
+    case EBuildable::Pipeline:
+    case EBuildable::Pipeline2:
+        return LoadClassSoft<AFGBuildablePipeline>(
+            Tier == 2 ? TEXT("/Game/FactoryGame/Buildable/Factory/PipelineMk2/Build_PipelineMK2.Build_PipelineMK2_C")
+                      : TEXT("/Game/FactoryGame/Buildable/Factory/Pipeline/Build_Pipeline.Build_Pipeline_C"),
+            Tier == 2 ? EBuildable::Pipeline2 : EBuildable::Pipeline);
+    default:
+        return GetBuildableClass<AFGBuildable>(Type);
+    }
+}
+
 int32 UBuildableCache::GetHighestUnlockedBeltTier(UWorld* World)
 {
     AFGRecipeManager* RecipeManager = AFGRecipeManager::Get(World);
@@ -140,14 +322,12 @@ int32 UBuildableCache::GetHighestUnlockedBeltTier(UWorld* World)
 
 void UBuildableCache::SetPipelineClass(int32 Tier)
 {
-    EBuildable PipeType = (Tier == 2) ? EBuildable::Pipeline2 : EBuildable::Pipeline;
-    FString Path = (Tier == 2)
-                       ? TEXT("/Game/FactoryGame/Buildable/Factory/PipelineMk2/Build_PipelineMK2.Build_PipelineMK2_C")
-                       : TEXT("/Game/FactoryGame/Buildable/Factory/Pipeline/Build_Pipeline.Build_Pipeline_C");
-
-    TSubclassOf<AFGBuildablePipeline> LoadedClass = LoadClassSoft<AFGBuildablePipeline>(Path, PipeType);
+    TSubclassOf<AFGBuildable> LoadedClass = GetTieredClass(EBuildable::Pipeline, Tier);
     if (LoadedClass)
+    {
         CachedClasses.Add(EBuildable::Pipeline, LoadedClass);
+        PipelineTier = Tier;
+    }
 }
 
 int32 UBuildableCache::GetHighestUnlockedPipelineTier(UWorld* World)
@@ -168,16 +348,46 @@ int32 UBuildableCache::GetHighestUnlockedPipelineTier(UWorld* World)
     return 1;
 }
 
+void UBuildableCache::SetPowerPoleTier(int32 Tier)
+{
+    MaxPowerPoleTier = FMath::Clamp(Tier, 1, 3);
+}
+
+int32 UBuildableCache::GetHighestUnlockedPowerPoleTier(UWorld* World)
+{
+    AFGRecipeManager* RecipeManager = AFGRecipeManager::Get(World);
+
+    // Check pole tiers from 3 down to 2, Mk1 is always available
+    for (int32 Tier = 3; Tier >= 2; --Tier)
+    {
+        FString RecipePath = FString::Printf(
+            TEXT("/Game/FactoryGame/Recipes/Buildings/Recipe_PowerPoleMk%d.Recipe_PowerPoleMk%d_C"), Tier, Tier);
+
+        TSoftClassPtr<UFGRecipe> SoftClass(RecipePath);
+        TSubclassOf<UFGRecipe> RecipeClass = SoftClass.LoadSynchronous();
+
+        if (RecipeClass && RecipeManager->IsRecipeAvailable(RecipeClass))
+        {
+            return Tier;
+        }
+    }
+
+    return 1;
+}
+
 //-------------------------------------------------
 // Recipe loader
 //-------------------------------------------------
 TSubclassOf<UFGRecipe> UBuildableCache::GetRecipeClass(const FString& Recipe,
                                                        TSubclassOf<AFGBuildableManufacturer> ProducedIn, UWorld* World)
 {
-    if (CachedRecipeClasses.Contains(Recipe))
-        return CachedRecipeClasses[Recipe];
-
     FString ProducedInName = ProducedIn->GetName();
+    const FString Key = GetRecipeKey(ProducedInName, Recipe);
+    if (const TSubclassOf<UFGRecipe>* Cached = CachedRecipeClasses.Find(Key))
+        return *Cached;
+    if (TSubclassOf<UFGRecipe> Indexed = FindIndexedRecipe(Key, ProducedIn, World))
+        return Indexed;
+
     if (WrongRecipes.ContainsByPredicate([&](const FWrongRecipe& Item)
                                          { return Item.Name == Recipe && Item.ProducedIn == ProducedInName; }))
         return nullptr;
@@ -185,10 +395,139 @@ TSubclassOf<UFGRecipe> UBuildableCache::GetRecipeClass(const FString& Recipe,
     TArray<TSubclassOf<UFGRecipe>> AvailableRecipes;
     AFGRecipeManager::Get(World)->GetAvailableRecipesForProducer(ProducedIn, AvailableRecipes);
 
+    TSubclassOf<UFGRecipe> FoundRecipe = FindRecipe(Recipe, AvailableRecipes);
+    if (!FoundRecipe)
+    {
+        WrongRecipes.Add({Recipe, ProducedInName});
+        FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Recipe '%s' not found. %s"), *Recipe,
+                                                              *GetAvailableRecipesMessage(ProducedInName,
+                                                                                          AvailableRecipes)));
+        return nullptr;
+    }
+
+    AddRecipeClass(Key, FoundRecipe);
+    SaveRecipeIndex();
+    return FoundRecipe;
+}
+
+bool UBuildableCache::ResolveRecipes(const TSet<FRecipeRequest>& Requests, UWorld* World, TArray<FString>& OutErrors)
+{
+    const int32 NumErrors = OutErrors.Num();
+
+    // One recipe list per machine class, however many rows use it
+    TMap<TSubclassOf<AFGBuildableManufacturer>, TArray<FString>> RecipesPerMachine;
+    for (const FRecipeRequest& Request : Requests)
+    {
+        if (!IsGenerator(Request.Machine))
+        {
+            UClass* Class = GetMachineClass(Request.Machine, Request.MachineClass);
+            if (Class && Class->IsChildOf<AFGBuildableManufacturer>())
+                RecipesPerMachine.FindOrAdd(Class).Add(Request.Recipe);
+            else
+                OutErrors.Add(FString::Printf(TEXT("Machine %s not found or takes no recipes"),
+                                              Request.MachineClass.IsEmpty() ? *GetEnumName(Request.Machine)
+                                                                             : *Request.MachineClass));
+            continue;
+        }
+
+        if (!FGeneratorFuels::Find(Request.Machine, Request.Recipe))
+            OutErrors.Add(FString::Printf(TEXT("Fuel '%s' not found. Available fuels for %s: %s"), *Request.Recipe,
+                                          *GetEnumName(Request.Machine),
+                                          *FString::Join(FGeneratorFuels::GetFuelNames(Request.Machine),
+                                                         TEXT(", "))));
+    }
+
+    for (const TPair<TSubclassOf<AFGBuildableManufacturer>, TArray<FString>>& Machine : RecipesPerMachine)
+    {
+        TSubclassOf<AFGBuildableManufacturer> ProducedIn = Machine.Key;
+        const FString ProducedInName = ProducedIn->GetName();
+
+        TArray<FString> Missing;
+        for (const FString& Recipe : Machine.Value)
+        {
+            const FString Key = GetRecipeKey(ProducedInName, Recipe);
+            if (!CachedRecipeClasses.Contains(Key) && !FindIndexedRecipe(Key, ProducedIn, World))
+                Missing.Add(Recipe);
+        }
+        if (Missing.IsEmpty())
+            continue;
+
+        TArray<TSubclassOf<UFGRecipe>> AvailableRecipes;
+        AFGRecipeManager::Get(World)->GetAvailableRecipesForProducer(ProducedIn, AvailableRecipes);
+
+        TArray<FString> NotFound;
+        for (const FString& Recipe : Missing)
+        {
+            if (TSubclassOf<UFGRecipe> FoundRecipe = FindRecipe(Recipe, AvailableRecipes))
+                AddRecipeClass(GetRecipeKey(ProducedInName, Recipe), FoundRecipe);
+            else
+                NotFound.Add(FString::Printf(TEXT("'%s'"), *Recipe));
+        }
+
+        if (NotFound.Num() > 0)
+            OutErrors.Add(FString::Printf(TEXT("Recipe %s not found. %s"), *FString::Join(NotFound, TEXT(", ")),
+                                          *GetAvailableRecipesMessage(ProducedInName, AvailableRecipes)));
+    }
+
+    SaveRecipeIndex();
+    return OutErrors.Num() == NumErrors;
+}
+
+FString UBuildableCache::GetRecipeKey(const FString& ProducedInName, const FString& Recipe)
+{
+    return ProducedInName + TEXT("/") + Recipe;
+}
+
+void UBuildableCache::LoadRecipeIndex()
+{
+    IndexedRecipes = FRecipeIndex::Load();
+    bRecipeIndexChanged = false;
+}
+
+TSubclassOf<UFGRecipe> UBuildableCache::FindIndexedRecipe(const FString& Key,
+                                                          TSubclassOf<AFGBuildableManufacturer> ProducedIn,
+                                                          UWorld* World)
+{
+    const FString* Path = IndexedRecipes.Find(Key);
+    if (!Path)
+        return nullptr;
+
+    // The index knows names, not what this savegame has unlocked
+    TSubclassOf<UFGRecipe> Recipe = TSoftClassPtr<UFGRecipe>(FSoftObjectPath(*Path)).LoadSynchronous();
+    if (!Recipe || !AFGRecipeManager::Get(World)->IsRecipeAvailable(Recipe) ||
+        !UFGRecipe::GetProducedIn(Recipe).Contains(ProducedIn.Get()))
+    {
+        IndexedRecipes.Remove(Key);
+        bRecipeIndexChanged = true;
+        return nullptr;
+    }
+
+    CachedRecipeClasses.Add(Key, Recipe);
+    return Recipe;
+}
+
+void UBuildableCache::AddRecipeClass(const FString& Key, TSubclassOf<UFGRecipe> Recipe)
+{
+    CachedRecipeClasses.Add(Key, Recipe);
+    IndexedRecipes.Add(Key, Recipe->GetPathName());
+    bRecipeIndexChanged = true;
+}
+
+void UBuildableCache::SaveRecipeIndex()
+{
+    if (!bRecipeIndexChanged)
+        return;
+    FRecipeIndex::Save(IndexedRecipes);
+    bRecipeIndexChanged = false;
+}
+
+TSubclassOf<UFGRecipe> UBuildableCache::FindRecipe(const FString& Recipe,
+                                                   const TArray<TSubclassOf<UFGRecipe>>& AvailableRecipes)
+{
     // Try to find by class name first (e.g., "IngotIron" -> "Recipe_IngotIron_C")
     FString FormattedName = FString::Printf(TEXT("Recipe_%s_C"), *Recipe);
-    TSubclassOf<UFGRecipe>* FoundRecipe = AvailableRecipes.FindByPredicate([&](const TSubclassOf<UFGRecipe>& R)
-                                                                           { return R->GetName() == FormattedName; });
+    const TSubclassOf<UFGRecipe>* FoundRecipe = AvailableRecipes.FindByPredicate(
+        [&](const TSubclassOf<UFGRecipe>& R) { return R->GetName() == FormattedName; });
 
     // If not found by class name, try to find by display name in PascalCase (e.g., "IronIngot" matches "Iron Ingot")
     if (!FoundRecipe)
@@ -207,44 +546,291 @@ TSubclassOf<UFGRecipe> UBuildableCache::GetRecipeClass(const FString& Recipe,
             });
     }
 
-    if (!FoundRecipe)
+    return FoundRecipe ? *FoundRecipe : nullptr;
+}
+
+FString UBuildableCache::GetAvailableRecipesMessage(const FString& ProducedInName,
+                                                    const TArray<TSubclassOf<UFGRecipe>>& AvailableRecipes)
+{
+    TArray<FString> Names;
+    for (const auto& R : AvailableRecipes)
     {
-        WrongRecipes.Add({Recipe, ProducedInName});
+        UFGRecipe* RecipeCDO = R->GetDefaultObject<UFGRecipe>();
+        FString DisplayName = RecipeCDO ? RecipeCDO->GetDisplayName().ToString() : TEXT("");
+        FString PascalCaseDisplayName = ToPascalCase(DisplayName);
+
+        FString N = R->GetName();
+        N.RemoveFromStart(TEXT("Recipe_"));
+        N.RemoveFromEnd(TEXT("_C"));
+
+        // Show PascalCase display name and class name
+        if (!PascalCaseDisplayName.IsEmpty() && PascalCaseDisplayName != N)
+            Names.Add(FString::Printf(TEXT("%s (%s)"), *PascalCaseDisplayName, *N));
+        else
+            Names.Add(N);
+    }
 
-        TArray<FString> Names;
-        for (const auto& R : AvailableRecipes)
-        {
-            UFGRecipe* RecipeCDO = R->GetDefaultObject<UFGRecipe>();
-            FString DisplayName = RecipeCDO ? RecipeCDO->GetDisplayName().ToString() : TEXT("");
-            FString PascalCaseDisplayName = ToPascalCase(DisplayName);
+    return Names.IsEmpty() ? FString::Printf(TEXT("Machine %s not unlocked yet!"), *ProducedInName)
+                           : FString::Printf(TEXT("Available recipes for %s: %s"), *ProducedInName,
+                                             *FString::Join(Names, TEXT(", ")));
+}
 
-            FString N = R->GetName();
-            N.RemoveFromStart(TEXT("Recipe_"));
-            N.RemoveFromEnd(TEXT("_C"));
+//-------------------------------------------------
+// Recipe descriptors
+//-------------------------------------------------
+FRecipeDescriptor UBuildableCache::GetRecipeDescriptor(TSubclassOf<UFGRecipe> Recipe, const FMachineConfig& Config)
+{
+    FRecipeDescriptor* Cached = RecipeRates.Find(Recipe);
+    if (!Cached)
+    {
+        Cached = &RecipeRates.Add(Recipe);
+        Cached->Duration = UFGRecipe::GetManufacturingDuration(Recipe);
+        GetItemRates(UFGRecipe::GetIngredients(Recipe), Cached->Duration, Cached->Ingredients, Cached->SolidIn,
+                     Cached->FluidIn);
+        GetItemRates(UFGRecipe::GetProducts(Recipe), Cached->Duration, Cached->Products, Cached->SolidOut,
+                     Cached->FluidOut);
+    }
 
-            // Show PascalCase display name and class name
-            if (!PascalCaseDisplayName.IsEmpty() && PascalCaseDisplayName != N)
-                Names.Add(FString::Printf(TEXT("%s (%s)"), *PascalCaseDisplayName, *N));
-            else
-                Names.Add(N);
+    FRecipeDescriptor Descriptor = *Cached;
+
+    int32 MaxBeltInput = Config.InputConnections[0].Belt.Num();
+    int32 MaxPipeInput = Config.InputConnections[0].Pipe.Num();
+    Descriptor.InputVariant = GetPortVariantIndex(MaxBeltInput, MaxPipeInput, Descriptor.SolidIn, Descriptor.FluidIn);
+
+    int32 MaxBeltOutput = Config.OutputConnections[0].Belt.Num();
+    int32 MaxPipeOutput = Config.OutputConnections[0].Pipe.Num();
+    Descriptor.OutputVariant =
+        GetPortVariantIndex(MaxBeltOutput, MaxPipeOutput, Descriptor.SolidOut, Descriptor.FluidOut);
+
+    return Descriptor;
+}
+
+//-------------------------------------------------
+// Build costs
+//-------------------------------------------------
+TSubclassOf<UFGRecipe> UBuildableCache::GetBuildRecipe(TSubclassOf<AFGBuildable> Buildable, UWorld* World)
+{
+    // One pass over all unlocked recipes, then a map lookup per buildable class
+    if (!bBuildRecipesLoaded)
+    {
+        bBuildRecipesLoaded = true;
+        TArray<TSubclassOf<UFGRecipe>> AvailableRecipes;
+        AFGRecipeManager::Get(World)->GetAllAvailableRecipes(AvailableRecipes);
+        for (TSubclassOf<UFGRecipe> Recipe : AvailableRecipes)
+        {
+            for (const FItemAmount& Product : UFGRecipe::GetProducts(Recipe))
+            {
+                TSubclassOf<UFGBuildingDescriptor> Descriptor = *Product.ItemClass;
+                if (Descriptor)
+                    BuildRecipes.Add(UFGBuildingDescriptor::GetBuildableClass(Descriptor), Recipe);
+            }
         }
+    }
 
-        FString Msg = Names.IsEmpty() ? FString::Printf(TEXT("Machine %s not unlocked yet!"), *ProducedInName)
-                                      : FString::Printf(TEXT("Available recipes for %s: %s"), *ProducedInName,
-                                                        *FString::Join(Names, TEXT(", ")));
+    const TSubclassOf<UFGRecipe>* Recipe = BuildRecipes.Find(Buildable);
+    return Recipe ? *Recipe : nullptr;
+}
+
+//-------------------------------------------------
+// Buildable pool
+//-------------------------------------------------
+const FName UBuildableCache::UnsavedTag(TEXT("FactorySpawnerUnsaved"));
 
-        FFactorySpawnerModule::ChatLog(World, FString::Printf(TEXT("Recipe '%s' not found. %s"), *Recipe, *Msg));
+AFGBuildable* UBuildableCache::AcquireBuildable(UWorld* World, TSubclassOf<AFGBuildable> Class,
+                                                const FTransform& Transform)
+{
+    if (!Class)
         return nullptr;
+
+    if (FBuildablePool* Pool = Pools.Find(Class))
+    {
+        while (Pool->Free.Num() > 0)
+        {
+            AFGBuildable* Buildable = Pool->Free.Pop(EAllowShrinking::No);
+            // Dismantled by a player or destroyed with the level
+            if (!IsValid(Buildable))
+                continue;
+
+            Buildable->SetActorTransform(Transform);
+            Buildable->SetActorEnableCollision(true);
+            Buildable->SetActorHiddenInGame(false);
+            return Buildable;
+        }
+    }
+
+    return World->SpawnActor<AFGBuildable>(Class, Transform);
+}
+
+bool UBuildableCache::ReleaseBuildable(AFGBuildable* Buildable)
+{
+    FBuildablePool& Pool = Pools.FindOrAdd(Buildable->GetClass());
+    if (Pool.Free.Num() >= MaxPooledPerClass)
+        return false;
+
+    // Belts, pipes and wires are destroyed by now, but the ports must not point at them anymore
+    TInlineComponentArray<UFGFactoryConnectionComponent*> FactoryConnections(Buildable);
+    for (UFGFactoryConnectionComponent* Connection : FactoryConnections)
+        Connection->ClearConnection();
+    TInlineComponentArray<UFGPipeConnectionComponent*> PipeConnections(Buildable);
+    for (UFGPipeConnectionComponent* Connection : PipeConnections)
+        Connection->ClearConnection();
+
+    // The next command sets the recipe, but only pastes clock and boost if they differ from 100%
+    if (AFGBuildableFactory* Factory = Cast<AFGBuildableFactory>(Buildable))
+    {
+        Factory->SetPendingPotential(1.0f);
+        Factory->SetPendingProductionBoost(1.0f);
+    }
+
+    Buildable->SetActorHiddenInGame(true);
+    Buildable->SetActorEnableCollision(false);
+    Buildable->Tags.AddUnique(UnsavedTag);
+    Pool.Free.Add(Buildable);
+    return true;
+}
+
+TSubclassOf<AFGBuildable> UBuildableCache::GetMachineClass(EBuildable Type, const FString& ClassPath)
+{
+    if (Type != EBuildable::CustomMachine)
+        return GetBuildableClass<AFGBuildable>(Type);
+
+    // Failed paths are kept as well, the error is logged once
+    if (const TSubclassOf<AFGBuildable>* Cached = CustomMachineClasses.Find(ClassPath))
+        return *Cached;
+    return CustomMachineClasses.Add(ClassPath, LoadClassSoft<AFGBuildable>(ClassPath, Type));
+}
+
+const FMachinePorts& UBuildableCache::GetMachinePorts(EBuildable Type, const FString& ClassPath)
+{
+    static const FMachinePorts NoPorts;
+    TSubclassOf<AFGBuildable> Class = GetMachineClass(Type, ClassPath);
+    if (!Class)
+        return NoPorts;
+    if (const TUniquePtr<FMachinePorts>* Ports = MachinePorts.Find(Class))
+        return **Ports;
+
+    FMachinePorts& Ports = *MachinePorts.Add(Class, MakeUnique<FMachinePorts>());
+    for (const TPair<const UFGFactoryConnectionComponent*, FTransform>& Connection :
+         GetTemplateComponents<UFGFactoryConnectionComponent>(Class))
+    {
+        Ports.Belt.Add(Connection.Value.GetLocation());
+        Ports.BeltIsInput.Add(Connection.Key->GetDirection() == EFactoryConnectionDirection::FCD_INPUT);
+    }
+    for (const TPair<const UFGPipeConnectionComponent*, FTransform>& Connection :
+         GetTemplateComponents<UFGPipeConnectionComponent>(Class))
+    {
+        Ports.Pipe.Add(Connection.Value.GetLocation());
+        Ports.PipeIsInput.Add(Connection.Key->GetPipeConnectionType() == EPipeConnectionType::PCT_CONSUMER);
+    }
+
+    // Without a clearance box the ports span the machine
+    Ports.Footprint = Class->GetDefaultObject<AFGBuildable>()->GetCombinedClearanceBox();
+    if (!Ports.Footprint.IsValid)
+    {
+        for (const FVector& Port : Ports.Belt)
+            Ports.Footprint += Port;
+        for (const FVector& Port : Ports.Pipe)
+            Ports.Footprint += Port;
+    }
+
+    Ports.DerivedConfig = FBuildPlanGenerator::DeriveMachineConfig(Ports);
+    const FMachineConfig* HandMade = FBuildPlanGenerator::FindMachineConfig(Type);
+    if (!HandMade)
+    {
+        Ports.Config = Ports.Footprint.IsValid ? &Ports.DerivedConfig : nullptr;
+        return Ports;
+    }
+
+    // Vanilla machines keep their hand-made layouts, the derived ones are checked against them so that the
+    // layouts of modded machines come from code that runs on every vanilla machine too
+    Ports.Config = HandMade;
+    if (IsSameLayout(*HandMade, Ports.DerivedConfig))
+        UE_LOG(LogFactorySpawner, Log, TEXT("%s: derived layout matches the hand-made one"), *GetEnumName(Type));
+    else
+        UE_LOG(LogFactorySpawner, Warning,
+               TEXT("%s: derived layout is %dx%d m with other ports than the hand-made %dx%d m one"),
+               *GetEnumName(Type), Ports.DerivedConfig.Width, Ports.DerivedConfig.Length, HandMade->Width,
+               HandMade->Length);
+    return Ports;
+}
+
+const FMachineConfig* UBuildableCache::GetMachineConfig(EBuildable Type, const FString& ClassPath)
+{
+    return Type < EBuildable::Splitter ? GetMachinePorts(Type, ClassPath).Config : nullptr;
+}
+
+FIntPoint UBuildableCache::GetMachineSize(EBuildable Type, const FString& ClassPath)
+{
+    const FMachineConfig* Config = GetMachineConfig(Type, ClassPath);
+    return Config ? FIntPoint(Config->Width, Config->Length) : FIntPoint::ZeroValue;
+}
+
+void UBuildableCache::CheckPortOrder(EBuildable Type, const FString& ClassPath, const AFGBuildable* Buildable)
+{
+    if (!Buildable)
+        return;
+    bool bAlreadyChecked = false;
+    CheckedPortOrders.Add(Buildable->GetClass(), &bAlreadyChecked);
+    if (bAlreadyChecked)
+        return;
+
+    // Plans address ports by their index among the actor's components, the layouts by the template walk
+    const FMachinePorts& Ports = GetMachinePorts(Type, ClassPath);
+    const FTransform& ActorTransform = Buildable->GetActorTransform();
+    auto IsSameOrder = [&](const auto& Components, const TArray<FVector>& Locations)
+    {
+        if (Components.Num() != Locations.Num())
+            return false;
+        for (int32 i = 0; i < Components.Num(); ++i)
+        {
+            const FVector Local = ActorTransform.InverseTransformPosition(Components[i]->GetComponentLocation());
+            if (!Local.Equals(Locations[i], 1.0f))
+                return false;
+        }
+        return true;
+    };
+
+    TInlineComponentArray<UFGFactoryConnectionComponent*> BeltConnections(Buildable);
+    TInlineComponentArray<UFGPipeConnectionComponent*> PipeConnections(Buildable);
+    if (!IsSameOrder(BeltConnections, Ports.Belt) || !IsSameOrder(PipeConnections, Ports.Pipe))
+        UE_LOG(LogFactorySpawner, Warning,
+               TEXT("%s: ports of the class defaults differ from those of a spawned machine, a derived layout "
+                    "would connect the wrong ports"),
+               *Buildable->GetClass()->GetName());
+}
+
+void UBuildableCache::DrainPool()
+{
+    int32 NumDestroyed = 0;
+    for (TPair<TSubclassOf<AFGBuildable>, FBuildablePool>& Pool : Pools)
+    {
+        for (AFGBuildable* Buildable : Pool.Value.Free)
+        {
+            if (IsValid(Buildable))
+            {
+                Buildable->Destroy();
+                ++NumDestroyed;
+            }
+        }
     }
+    Pools.Empty();
 
-    CachedRecipeClasses.Add(Recipe, *FoundRecipe);
-    return *FoundRecipe;
+    if (NumDestroyed > 0)
+        UE_LOG(LogFactorySpawner, Log, TEXT("Destroyed %d pooled buildables"), NumDestroyed);
 }
 
 void UBuildableCache::ClearCache()
 {
+    DrainPool();
     CachedClasses.Empty();
     CachedRecipeClasses.Empty();
     WrongRecipes.Empty();
+    RecipeRates.Empty();
+    BuildRecipes.Empty();
+    bBuildRecipesLoaded = false;
+    CustomMachineClasses.Empty();
+    MachinePorts.Empty();
+    CheckedPortOrders.Empty();
+    BeltTier = PipelineTier = MaxPowerPoleTier = 1;
     UE_LOG(LogFactorySpawner, Log, TEXT("Cache cleared"));
 }
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "ClockPlanner.h"
+
+namespace
+{
+    // Power usage grows with clock^log2(2.5)
+    constexpr float ClockPowerExponent = 1.321928f;
+
+    // Each power shard adds 50% clock on top of 100%
+    constexpr float ClockPerShard = 50.0f;
+
+    // Machines cannot be clocked below 1%
+    constexpr float MinClockPercent = 1.0f;
+
+    // Fully slotted machines first: amplification is linear in sloops, but the power penalty is quadratic
+    float DistributeSomersloops(int32 Count, int32 Slots, int32 Somersloops, FClockPlan& Plan)
+    {
+        Plan.MachineCount = Count;
+        Plan.Somersloops.SetNumZeroed(Count);
+        int32 SloopsLeft = Slots > 0 ? Somersloops : 0;
+        float TotalBoost = 0.0f;
+        for (int32 i = 0; i < Count; ++i)
+        {
+            Plan.Somersloops[i] = FMath::Min(Slots, SloopsLeft);
+            SloopsLeft -= Plan.Somersloops[i];
+            TotalBoost += Plan.GetProductionBoost(i, Slots);
+        }
+        return TotalBoost;
+    }
+} // namespace
+
+float FClockPlan::GetProductionBoost(int32 MachineIndex, int32 Slots) const
+{
+    if (Slots <= 0 || !Somersloops.IsValidIndex(MachineIndex))
+        return 1.0f;
+    return 1.0f + (float) Somersloops[MachineIndex] / Slots;
+}
+
+float FClockPlan::GetClockPercent(int32 MachineIndex) const
+{
+    return LastClockPercent > 0.0f && MachineIndex == MachineCount - 1 ? LastClockPercent : ClockPercent;
+}
+
+int32 FClockPlanner::GetSomersloopSlots(EBuildable Machine)
+{
+    switch (Machine)
+    {
+    case EBuildable::Smelter:
+    case EBuildable::Constructor:
+        return 1;
+    case EBuildable::Assembler:
+    case EBuildable::Foundry:
+    case EBuildable::OilRefinery:
+    case EBuildable::Packager:
+    case EBuildable::Converter:
+        return 2;
+    case EBuildable::Manufacturer:
+    case EBuildable::Blender:
+    case EBuildable::ParticleAccelerator:
+    case EBuildable::QuantumEncoder:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+float FClockPlanner::GetPowerConsumption(EBuildable Machine)
+{
+    switch (Machine)
+    {
+    case EBuildable::Smelter:
+    case EBuildable::Constructor:
+        return 4.0f;
+    case EBuildable::Packager:
+        return 10.0f;
+    case EBuildable::Assembler:
+        return 15.0f;
+    case EBuildable::Foundry:
+        return 16.0f;
+    case EBuildable::OilRefinery:
+        return 30.0f;
+    case EBuildable::Manufacturer:
+        return 55.0f;
+    case EBuildable::Blender:
+        return 75.0f;
+    case EBuildable::Converter:
+        return 250.0f;
+    case EBuildable::ParticleAccelerator:
+    case EBuildable::QuantumEncoder:
+        return 1000.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+int32 FClockPlanner::GetPowerShardsForClock(float ClockPercent)
+{
+    return FMath::Clamp(FMath::CeilToInt((ClockPercent - 100.0f - KINDA_SMALL_NUMBER) / ClockPerShard), 0, 3);
+}
+
+float FClockPlanner::GetMachinePower(EBuildable Machine, float ClockPercent, float ProductionBoost)
+{
+    return GetPowerConsumption(Machine) * FMath::Pow(ClockPercent / 100.0f, ClockPowerExponent) *
+           FMath::Square(ProductionBoost);
+}
+
+bool FClockPlanner::PlanForRate(EBuildable Machine, float BaseRate, float TargetRate, int32 MaxMachines,
+                                float MaxClock, int32 Somersloops, FClockPlan& OutPlan)
+{
+    const int32 Slots = GetSomersloopSlots(Machine);
+    MaxClock = FMath::Clamp(MaxClock, 1.0f, MaxClockPercent);
+    if (BaseRate <= 0.0f)
+        return false;
+
+    if (MaxMachines <= 0)
+        return false;
+
+    // Machines at MaxClock needed for the rate; fully slotted machines count twice and are placed first
+    const double Needed = TargetRate / (BaseRate * MaxClock / 100.0);
+    const double SloopMachines = Slots > 0 ? (double) Somersloops / Slots : 0.0;
+    const int32 FullSloopMachines = FMath::FloorToInt32(SloopMachines);
+    const double FewestMachines =
+        Needed <= 2.0 * FullSloopMachines
+            ? FMath::CeilToDouble(Needed / 2.0 - KINDA_SMALL_NUMBER)
+            : FMath::Max(FullSloopMachines + 1.0, FMath::CeilToDouble(Needed - SloopMachines - KINDA_SMALL_NUMBER));
+    int32 Count = (int32) FMath::Clamp(FewestMachines, 1.0, (double) MaxMachines);
+
+    // Rounding may leave the last step short by a hair
+    FClockPlan Plan;
+    float Clock = TargetRate / (BaseRate * DistributeSomersloops(Count, Slots, Somersloops, Plan)) * 100.0f;
+    while (Clock > MaxClock + KINDA_SMALL_NUMBER && Count < MaxMachines)
+        Clock = TargetRate / (BaseRate * DistributeSomersloops(++Count, Slots, Somersloops, Plan)) * 100.0f;
+
+    Plan.ClockPercent = FMath::Min(Clock, MaxClock);
+    Evaluate(Machine, BaseRate, Plan);
+    OutPlan = MoveTemp(Plan);
+    return Clock <= MaxClock + KINDA_SMALL_NUMBER;
+}
+
+bool FClockPlanner::PlanForPower(EBuildable Machine, float BaseRate, float TargetRate, int32 MinMachines,
+                                 int32 MaxMachines, float MaxClock, int32 Somersloops, FClockPlan& OutPlan)
+{
+    const int32 Slots = GetSomersloopSlots(Machine);
+    MaxClock = FMath::Clamp(MaxClock, MinClockPercent, MaxClockPercent);
+    const float FullClock = FMath::Min(100.0f, MaxClock);
+    if (BaseRate <= 0.0f)
+        return false;
+
+    bool bFound = false;
+    auto Consider = [&](FClockPlan& Plan)
+    {
+        Evaluate(Machine, BaseRate, Plan);
+        if (!bFound || Plan.PowerUsage < OutPlan.PowerUsage - KINDA_SMALL_NUMBER)
+        {
+            OutPlan = Plan;
+            bFound = true;
+        }
+    };
+
+    for (int32 Count = FMath::Max(MinMachines, 1); Count <= MaxMachines; ++Count)
+    {
+        FClockPlan Plan;
+        const float TotalBoost = DistributeSomersloops(Count, Slots, Somersloops, Plan);
+
+        // One clock for all machines
+        const float Clock = TargetRate / (BaseRate * TotalBoost) * 100.0f;
+        if (Clock > MaxClock + KINDA_SMALL_NUMBER)
+            continue;
+        if (Clock >= MinClockPercent)
+        {
+            Plan.ClockPercent = Clock;
+            Consider(Plan);
+        }
+
+        // All but the last machine at full clock, the last one makes the rest
+        const float LastBoost = Plan.GetProductionBoost(Count - 1, Slots);
+        const float LastClock = (TargetRate - BaseRate * FullClock / 100.0f * (TotalBoost - LastBoost)) /
+                                (BaseRate * LastBoost) * 100.0f;
+        if (Count > 1 && LastClock >= MinClockPercent && LastClock < FullClock - KINDA_SMALL_NUMBER)
+        {
+            Plan.ClockPercent = FullClock;
+            Plan.LastClockPercent = LastClock;
+            Consider(Plan);
+        }
+
+        // More machines only pay off as long as they can run at least at the lowest clock
+        if (Clock < MinClockPercent)
+            break;
+    }
+
+    if (!bFound)
+        PlanForRate(Machine, BaseRate, TargetRate, MaxMachines, MaxClock, Somersloops, OutPlan);
+    return bFound;
+}
+
+void FClockPlanner::Evaluate(EBuildable Machine, float BaseRate, FClockPlan& Plan)
+{
+    const int32 Slots = GetSomersloopSlots(Machine);
+    Plan.PowerShardsPerMachine = GetPowerShardsForClock(Plan.ClockPercent);
+    Plan.OutputRate = 0.0f;
+    Plan.PowerUsage = 0.0f;
+    for (int32 i = 0; i < Plan.MachineCount; ++i)
+    {
+        const float Boost = Plan.GetProductionBoost(i, Slots);
+        const float Clock = Plan.GetClockPercent(i);
+        Plan.OutputRate += BaseRate * Clock / 100.0f * Boost;
+        Plan.PowerUsage += GetMachinePower(Machine, Clock, Boost);
+    }
+}
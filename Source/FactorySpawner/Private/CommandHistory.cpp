@@ -0,0 +1,96 @@
+#include "CommandHistory.h"
+#include "FactorySpawner.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    // Roll over at about 20000 commands
+    constexpr int64 MaxHistoryBytes = 4 * 1024 * 1024;
+
+    const TCHAR* HistoryHeader = TEXT("Time,GameVersion,ModVersion,Kind,Result,CommandHash,Rows,Machines,Buildables,"
+                                      "Connections,BuildablesPerType,ParseMs,RecipesMs,PlanMs,SpawnMs,BlueprintMs,"
+                                      "DestroyMs,PeakMemoryDeltaMB\n");
+
+    FString GetModVersion()
+    {
+        const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("FactorySpawner"));
+        return Plugin.IsValid() ? Plugin->GetDescriptor().VersionName : TEXT("unknown");
+    }
+} // namespace
+
+FCommandRecord::FCommandRecord(const FString& InKind, const FString& Command) : Kind(InKind)
+{
+    CommandHash = FCrc::StrCrc32(*Command.TrimStartAndEnd().ToLower());
+    MemoryAtStart = PeakMemory = FPlatformMemory::GetStats().UsedPhysical;
+    PhaseStart = FPlatformTime::Seconds();
+}
+
+void FCommandRecord::EndPhase(double& PhaseMs)
+{
+    const double Now = FPlatformTime::Seconds();
+    PhaseMs += (Now - PhaseStart) * 1000.0;
+    PhaseStart = Now;
+    SampleMemory();
+}
+
+void FCommandRecord::SetPlan(const FBuildPlanView& Plan)
+{
+    Rows = Machines = 0;
+    BuildablesPerType.Reset();
+    for (const FPlannedBuildable& Buildable : Plan.Buildables)
+    {
+        ++BuildablesPerType.FindOrAdd(Buildable.Type);
+        Rows = FMath::Max(Rows, Buildable.Row + 1);
+        if (Buildable.Type < EBuildable::Splitter)
+            ++Machines;
+    }
+    Buildables = Plan.Buildables.Num();
+    Connections = Plan.Connections.Num();
+}
+
+void FCommandRecord::SampleMemory()
+{
+    PeakMemory = FMath::Max<uint64>(PeakMemory, FPlatformMemory::GetStats().UsedPhysical);
+}
+
+FString FCommandHistory::GetPath()
+{
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FactorySpawner"), TEXT("History.csv"));
+}
+
+void FCommandHistory::Append(const FCommandRecord& Record, const TCHAR* Result)
+{
+    const FString Path = GetPath();
+    IFileManager& FileManager = IFileManager::Get();
+
+    const int64 Size = FileManager.FileSize(*Path);
+    if (Size > MaxHistoryBytes)
+        FileManager.Move(*FPaths::Combine(FPaths::GetPath(Path), TEXT("History.1.csv")), *Path);
+
+    TArray<EBuildable> Types;
+    Record.BuildablesPerType.GetKeys(Types);
+    Types.Sort();
+    TArray<FString> PerType;
+    for (EBuildable Type : Types)
+        PerType.Add(FString::Printf(TEXT("%s:%d"), *StaticEnum<EBuildable>()->GetNameStringByValue((int64) Type),
+                                    Record.BuildablesPerType[Type]));
+
+    FString Line = Size > 0 && Size <= MaxHistoryBytes ? FString() : FString(HistoryHeader);
+    Line += FString::Printf(TEXT("%s,%s,%s,%s,%s,%08x,%d,%d,%d,%d,%s,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.1f\n"),
+                            *FDateTime::UtcNow().ToIso8601(), *FEngineVersion::Current().ToString(),
+                            *GetModVersion(), *Record.Kind, Result, Record.CommandHash, Record.Rows,
+                            Record.Machines, Record.Buildables, Record.Connections,
+                            *FString::Join(PerType, TEXT(" ")), Record.ParseMs, Record.RecipesMs, Record.PlanMs,
+                            Record.SpawnMs, Record.BlueprintMs, Record.DestroyMs,
+                            (Record.PeakMemory - Record.MemoryAtStart) / (1024.0 * 1024.0));
+
+    if (!FFileHelper::SaveStringToFile(Line, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM,
+                                       &FileManager, FILEWRITE_Append))
+        UE_LOG(LogFactorySpawner, Warning, TEXT("Could not write %s"), *Path);
+}
@@ -28,126 +28,268 @@ static inline EBuildable ParseBuildableFromString(const FString& Input)
     return Found ? *Found : EBuildable::Invalid;
 }
 
-bool FFactoryCommandParser::ParseCommand(const FString& Input, TArray<FFactoryCommandToken>& OutTokens,
-                                         FString& OutError)
+static inline bool ParsePowerSchemeFromString(const FString& Input, EPowerScheme& OutScheme)
 {
-    OutTokens.Reset();
+    static const TMap<FString, EPowerScheme> PowerSchemeMap = {{TEXT("poles"), EPowerScheme::Poles},
+                                                               {TEXT("wall"), EPowerScheme::WallOutlets},
+                                                               {TEXT("walloutlets"), EPowerScheme::WallOutlets},
+                                                               {TEXT("chain"), EPowerScheme::Chained},
+                                                               {TEXT("chained"), EPowerScheme::Chained}};
+
+    const EPowerScheme* Found = PowerSchemeMap.Find(Input.ToLower());
+    if (Found)
+        OutScheme = *Found;
+    return Found != nullptr;
+}
 
-    // Check for optional beltTier parameter at the end
-    TOptional<int32> BeltTier;
-    FString CommandInput = Input;
+// Parses a "key=value" row option like "rate=90" or "sloops=4"
+static bool ParseRowOption(const FString& Option, int32 GroupIndex, FFactoryCommandToken& Token, FString& OutError)
+{
+    FString Key, Value;
+    Option.Split(TEXT("="), &Key, &Value);
 
-    // Look for "beltTier N" pattern (case-insensitive)
-    int32 BeltTierIndex = CommandInput.Find(TEXT("beltTier"), ESearchCase::IgnoreCase, ESearchDir::FromEnd);
-    if (BeltTierIndex != INDEX_NONE)
+    if (Key.Equals(TEXT("rate"), ESearchCase::IgnoreCase))
     {
-        // Extract everything after "beltTier"
-        FString BeltTierPart = CommandInput.RightChop(BeltTierIndex + 8).TrimStartAndEnd(); // 8 = len("beltTier")
+        Value.RemoveFromEnd(TEXT("/min"));
+        float Rate;
+        if (!LexTryParseString(Rate, *Value) || Rate <= 0.0f)
+        {
+            OutError = FString::Printf(TEXT("Group %d: rate must be a positive number per minute, got '%s'"),
+                                       GroupIndex + 1, *Value);
+            return false;
+        }
+        Token.TargetRate = Rate;
+        return true;
+    }
 
-        // Check if there's a comma before beltTier
-        FString BeforeBeltTier = CommandInput.Left(BeltTierIndex).TrimEnd();
-        if (BeforeBeltTier.EndsWith(TEXT(",")))
+    if (Key.Equals(TEXT("sloops"), ESearchCase::IgnoreCase) || Key.Equals(TEXT("somersloops"), ESearchCase::IgnoreCase))
+    {
+        int32 Sloops;
+        if (!LexTryParseString(Sloops, *Value) || Sloops < 0)
         {
-            BeforeBeltTier = BeforeBeltTier.LeftChop(1).TrimEnd();
+            OutError =
+                FString::Printf(TEXT("Group %d: sloops must be 0 or more, got '%s'"), GroupIndex + 1, *Value);
+            return false;
         }
+        Token.Somersloops = Sloops;
+        return true;
+    }
 
-        // Parse the tier number
-        int32 Tier;
-        if (!LexTryParseString(Tier, *BeltTierPart) || Tier < 1 || Tier > 6)
+    // "machines=4-12" (or "machines=12") is the count range the power solver may use
+    if (Key.Equals(TEXT("machines"), ESearchCase::IgnoreCase))
+    {
+        FString MinValue = Value, MaxValue = Value;
+        Value.Split(TEXT("-"), &MinValue, &MaxValue);
+        int32 MinMachines, MaxMachines;
+        if (!LexTryParseString(MinMachines, *MinValue) || !LexTryParseString(MaxMachines, *MaxValue) ||
+            MinMachines <= 0 || MaxMachines < MinMachines)
         {
-            OutError = FString::Printf(TEXT("beltTier must be 1-6, got '%s'"), *BeltTierPart);
+            OutError = FString::Printf(TEXT("Group %d: machines must be a count range like 4-12, got '%s'"),
+                                       GroupIndex + 1, *Value);
             return false;
         }
+        Token.MinMachines = MinMachines;
+        Token.Count = MaxMachines;
+        return true;
+    }
 
-        BeltTier = Tier;
-        CommandInput = BeforeBeltTier;
+    if (Key.Equals(TEXT("inputs"), ESearchCase::IgnoreCase))
+    {
+        if (!Value.Equals(TEXT("mixed"), ESearchCase::IgnoreCase) &&
+            !Value.Equals(TEXT("separate"), ESearchCase::IgnoreCase))
+        {
+            OutError = FString::Printf(TEXT("Group %d: inputs must be mixed or separate, got '%s'"), GroupIndex + 1,
+                                       *Value);
+            return false;
+        }
+        Token.bMixedInputs = Value.Equals(TEXT("mixed"), ESearchCase::IgnoreCase);
+        return true;
     }
 
+    OutError = FString::Printf(TEXT("Group %d: unknown option '%s'. Choose: rate=N, sloops=N, machines=A-B or "
+                                    "inputs=mixed"),
+                               GroupIndex + 1, *Option);
+    return false;
+}
+
+bool FFactoryCommandParser::ParseCommand(const FString& Input, TArray<FFactoryCommandToken>& OutTokens,
+                                         FString& OutError)
+{
+    OutTokens.Reset();
+
+    // Command-level groups (beltTier, power, floor) are collected while the rows are parsed
+    FFactoryCommandOptions Options;
+
     // Split groups by comma
     TArray<FString> Groups;
-    CommandInput.ParseIntoArray(Groups, TEXT(","), true);
+    Input.ParseIntoArray(Groups, TEXT(","), true);
 
     for (int32 g = 0; g < Groups.Num(); ++g)
     {
-        FString Group = Groups[g].TrimStartAndEnd();
-        if (Group.IsEmpty())
-            continue;
+        TOptional<FFactoryCommandToken> Row;
+        if (!ParseGroup(Groups[g], g, Options, Row, OutError))
+            return false;
+        if (Row.IsSet())
+            OutTokens.Add(Row.GetValue());
+    }
+
+    // Command-level options apply to all rows, wherever they were given
+    for (FFactoryCommandToken& Token : OutTokens)
+        ApplyOptions(Options, Token);
+
+    return true;
+}
+
+void FFactoryCommandParser::ApplyOptions(const FFactoryCommandOptions& Options, FFactoryCommandToken& Token)
+{
+    Token.BeltTier = Options.BeltTier;
+    Token.PowerScheme = Options.PowerScheme;
+    Token.FloorHeight = Options.FloorHeight;
+}
+
+bool FFactoryCommandParser::ParseGroup(const FString& Input, int32 GroupIndex, FFactoryCommandOptions& InOutOptions,
+                                       TOptional<FFactoryCommandToken>& OutRow, FString& OutError)
+{
+    OutRow.Reset();
 
-        TArray<FString> Parts;
-        Group.ParseIntoArrayWS(Parts);
+    const int32 g = GroupIndex;
+    FString Group = Input.TrimStartAndEnd();
+    if (Group.IsEmpty())
+        return true;
 
-        // Enforce 2 - 4 parts
-        if (Parts.Num() < 2 || Parts.Num() > 4)
+    TArray<FString> Parts;
+    Group.ParseIntoArrayWS(Parts);
+
+    // Optional "power poles|wall|chain" group, applies to all rows
+    if (Parts.Num() == 2 && Parts[0].Equals(TEXT("power"), ESearchCase::IgnoreCase))
+    {
+        if (!ParsePowerSchemeFromString(Parts[1], InOutOptions.PowerScheme))
         {
-            OutError = FString::Printf(
-                TEXT("Group %d: expected 2 - 4 tokens (count machine [recipe] [clock%%]), got %d: '%s'"), g + 1,
-                Parts.Num(), *Group);
+            OutError = FString::Printf(TEXT("power must be poles, wall or chain, got '%s'"), *Parts[1]);
             return false;
         }
+        return true;
+    }
 
-        int32 Count;
-        if (!LexTryParseString(Count, *Parts[0]) || Count <= 0)
+    // Optional "floor 1|2|4" group: foundations of that height under every row, "floor 0" for none
+    if (Parts.Num() == 2 && Parts[0].Equals(TEXT("floor"), ESearchCase::IgnoreCase))
+    {
+        int32 Height;
+        if (!LexTryParseString(Height, *Parts[1]) || (Height != 0 && Height != 1 && Height != 2 && Height != 4))
         {
-            OutError = FString::Printf(TEXT("Group %d: count must be positive, got '%s'"), g + 1, *Parts[0]);
+            OutError = FString::Printf(TEXT("floor must be 1, 2 or 4 (m) or 0 for none, got '%s'"), *Parts[1]);
             return false;
         }
+        InOutOptions.FloorHeight = Height;
+        return true;
+    }
 
-        FFactoryCommandToken Token{Count};
-
-        // Part 2: machine type
-
-        EBuildable EnumVal = ParseBuildableFromString(Parts[1]);
-        if (EnumVal == EBuildable::Invalid)
+    // Optional "beltTier N" group
+    if (Parts.Num() == 2 && Parts[0].Equals(TEXT("beltTier"), ESearchCase::IgnoreCase))
+    {
+        int32 Tier;
+        if (!LexTryParseString(Tier, *Parts[1]) || Tier < 1 || Tier > 6)
         {
-            OutError = FString::Printf(TEXT("Group %d: unknown machine type '%s'. Choose: Constructor, "
-                                            "Assembler, Manufacturer, Packager, Refinery, Blender, "
-                                            "ParticleAccelerator, Converter, QuantumEncoder, Smelter, Foundry, "
-                                            "CoalGenerator, FuelGenerator or NuclearReactor!"),
-                                       g + 1, *Parts[1]);
+            OutError = FString::Printf(TEXT("beltTier must be 1-6, got '%s'"), *Parts[1]);
             return false;
         }
-        Token.MachineType = EnumVal;
+        InOutOptions.BeltTier = Tier;
+        return true;
+    }
 
-        // Part 3: optional recipe
-        if (Parts.Num() >= 3)
+    // Optional "key=value" row options can be anywhere after the machine type
+    TArray<FString> Options;
+    for (int32 i = Parts.Num() - 1; i >= 2; --i)
+    {
+        if (Parts[i].Contains(TEXT("=")))
         {
-            Token.Recipe = Parts[2];
+            Options.Insert(Parts[i], 0);
+            Parts.RemoveAt(i);
         }
+    }
+
+    // Enforce 2 - 4 parts
+    if (Parts.Num() < 2 || Parts.Num() > 4)
+    {
+        OutError =
+            FString::Printf(TEXT("Group %d: expected 2 - 4 tokens (count machine [recipe] [clock%%]), got %d: '%s'"),
+                            g + 1, Parts.Num(), *Group);
+        return false;
+    }
+
+    FFactoryCommandToken Token;
+    for (const FString& Option : Options)
+    {
+        if (!ParseRowOption(Option, g, Token, OutError))
+            return false;
+    }
 
-        // Part 4: optional clock percent
-        if (Parts.Num() == 4)
+    if (Token.MinMachines > 0 && !Token.TargetRate.IsSet())
+    {
+        OutError = FString::Printf(TEXT("Group %d: machines=A-B needs a rate=N to plan for"), g + 1);
+        return false;
+    }
+
+    // "auto" leaves the machine count to the rate planner, a machines range replaces the count
+    int32 Count = 0;
+    const bool bAutoCount = Token.TargetRate.IsSet() && Parts[0].Equals(TEXT("auto"), ESearchCase::IgnoreCase);
+    if (!bAutoCount && (!LexTryParseString(Count, *Parts[0]) || Count <= 0))
+    {
+        OutError = FString::Printf(TEXT("Group %d: count must be positive, got '%s'"), g + 1, *Parts[0]);
+        return false;
+    }
+    if (Token.MinMachines == 0)
+        Token.Count = Count;
+
+    // Part 2: machine type, or the class path of any other production building
+
+    EBuildable EnumVal =
+        Parts[1].StartsWith(TEXT("/")) ? EBuildable::CustomMachine : ParseBuildableFromString(Parts[1]);
+    if (EnumVal == EBuildable::Invalid)
+    {
+        OutError = FString::Printf(TEXT("Group %d: unknown machine type '%s'. Choose: Constructor, "
+                                        "Assembler, Manufacturer, Packager, Refinery, Blender, "
+                                        "ParticleAccelerator, Converter, QuantumEncoder, Smelter, Foundry, "
+                                        "CoalGenerator, FuelGenerator, NuclearReactor or a class path!"),
+                                   g + 1, *Parts[1]);
+        return false;
+    }
+    Token.MachineType = EnumVal;
+    if (EnumVal == EBuildable::CustomMachine)
+        Token.MachineClass = Parts[1];
+
+    // Part 3: optional recipe
+    if (Parts.Num() >= 3)
+    {
+        Token.Recipe = Parts[2];
+    }
+
+    // Part 4: optional clock percent
+    if (Parts.Num() == 4)
+    {
+        FString ClockToken = Parts[3].TrimStartAndEnd();
+        if (ClockToken.EndsWith(TEXT("%")))
         {
-            FString ClockToken = Parts[3].TrimStartAndEnd();
-            if (ClockToken.EndsWith(TEXT("%")))
-            {
-                ClockToken = ClockToken.LeftChop(1);
-            }
-            float ClockSpeed;
-            if (!LexTryParseString(ClockSpeed, *ClockToken))
-            {
-                OutError = FString::Printf(
-                    TEXT("Group %d: invalid clock percent '%s' (must be numeric, optionally with decimal point)"),
-                    g + 1, *Parts[3]);
-                return false;
-            }
-
-            if (ClockSpeed <= 0.0f || ClockSpeed >= 100.0f)
-            {
-                OutError = FString::Printf(TEXT("Group %d: clock must be 0-100, got %.1f"), g + 1, ClockSpeed);
-                return false;
-            }
-
-            Token.ClockPercent = ClockSpeed;
+            ClockToken = ClockToken.LeftChop(1);
+        }
+        float ClockSpeed;
+        if (!LexTryParseString(ClockSpeed, *ClockToken))
+        {
+            OutError = FString::Printf(
+                TEXT("Group %d: invalid clock percent '%s' (must be numeric, optionally with decimal point)"), g + 1,
+                *Parts[3]);
+            return false;
         }
 
-        // Apply belt tier if specified
-        if (BeltTier.IsSet())
+        if (ClockSpeed <= 0.0f || ClockSpeed > 250.0f)
         {
-            Token.BeltTier = BeltTier.GetValue();
+            OutError = FString::Printf(TEXT("Group %d: clock must be 0-250, got %.1f"), g + 1, ClockSpeed);
+            return false;
         }
 
-        OutTokens.Add(Token);
+        Token.ClockPercent = ClockSpeed;
     }
 
+    OutRow = Token;
     return true;
 }
@@ -1,13 +1,38 @@
 #include "FactorySpawner.h"
 #include "FGChatManager.h"
 #include "Engine/World.h"
+#include "Command/CommandSender.h"
+#include "Buildables/FGBuildable.h"
+#include "BuildableCache.h"
+#include "Patching/NativeHookManager.h"
 
 #define LOCTEXT_NAMESPACE "FFactorySpawnerModule"
 
 DEFINE_LOG_CATEGORY(LogFactorySpawner);
 
+UCommandSender* FFactorySpawnerModule::ChatTarget = nullptr;
+
+void FFactorySpawnerModule::StartupModule()
+{
+#if !WITH_EDITOR
+    // Pooled buildables are hidden leftovers, and a job's buildables only count once the job is done
+    SUBSCRIBE_METHOD_VIRTUAL(AFGBuildable::ShouldSave_Implementation, GetMutableDefault<AFGBuildable>(),
+                             [](TCallScope<bool (*)(const AFGBuildable*)>& Scope, const AFGBuildable* Buildable)
+                             {
+                                 if (Buildable->Tags.Contains(UBuildableCache::UnsavedTag))
+                                     Scope.Override(false);
+                             });
+#endif
+}
+
 void FFactorySpawnerModule::ChatLog(UWorld* World, const FString& Message)
 {
+    if (IsValid(ChatTarget))
+    {
+        ChatTarget->SendChatMessage(Message);
+        return;
+    }
+
     AFGChatManager* ChatMgr = AFGChatManager::Get(World);
     FChatMessageStruct NewMessage;
     NewMessage.MessageText = FText::FromString(Message);
@@ -20,6 +45,16 @@ void FFactorySpawnerModule::ChatLog(UWorld* World, const FString& Message)
     ChatMgr->BroadcastChatMessage(NewMessage);
 }
 
+FFactorySpawnerModule::FScopedChatTarget::FScopedChatTarget(UCommandSender* Sender) : Previous(ChatTarget)
+{
+    ChatTarget = Sender;
+}
+
+FFactorySpawnerModule::FScopedChatTarget::~FScopedChatTarget()
+{
+    ChatTarget = Previous;
+}
+
 #undef LOCTEXT_NAMESPACE
 
 IMPLEMENT_MODULE(FFactorySpawnerModule, FactorySpawner)
\ No newline at end of file
@@ -7,7 +7,31 @@
 #include "FactoryCommandParser.h"
 #include "FactorySpawner.h"
 #include "BuildPlanGenerator.h"
+#include "BuildPlanSpawner.h"
+#include "PlanClearance.h"
+#include "PlanDiff.h"
+#include "PlanStatistics.h"
+#include "PlanFileReader.h"
 #include "EngineUtils.h"
+#include "TimerManager.h"
+#include "FGPlayerController.h"
+#include "Engine/World.h"
+
+namespace
+{
+    // Pooled buildables live in the world, keep them only while commands follow each other quickly
+    constexpr float PoolIdleSeconds = 60.0f;
+
+    // Time per frame spent on spawn jobs, shared by all players
+    constexpr double SpawnBudgetSeconds = 0.008;
+
+    // place: how far the player may aim
+    constexpr float MaxPlaceDistance = 10000.0f;
+
+    // place: how many cells the factory may be moved to get clear of existing buildables
+    constexpr int32 MaxClearanceShift = 3;
+    constexpr int32 MaxReportedConflicts = 5;
+} // namespace
 
 AFactorySpawnerChat* AFactorySpawnerChat::Get(UWorld* World)
 {
@@ -26,6 +50,7 @@ void AFactorySpawnerChat::BeginPlay()
         BuildableCache = NewObject<UBuildableCache>(this);
 
     ResetSubsystemData();
+    BuildableCache->LoadRecipeIndex();
     FFactorySpawnerModule::ChatLog(
         GetWorld(),
         TEXT("FactorySpawner loaded! Tool to generate commands: https://uniquesimon.github.io/satisfactory-planner/"));
@@ -33,6 +58,13 @@ void AFactorySpawnerChat::BeginPlay()
 
 void AFactorySpawnerChat::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+    GetWorldTimerManager().ClearTimer(DrainPoolTimer);
+    for (const TUniquePtr<FSpawnJob>& Job : Jobs)
+    {
+        Job->Spawner->Cancel();
+        RecordJob(*Job, TEXT("cancelled"));
+    }
+    Jobs.Empty();
     ResetSubsystemData();
     BuildableCache = nullptr;
 
@@ -45,23 +77,98 @@ void AFactorySpawnerChat::ResetSubsystemData()
     {
         BuildableCache->ClearCache();
     }
+    RecentPlans.Empty();
+    LastServed.Empty();
 }
 
 AFactorySpawnerChat::AFactorySpawnerChat()
 {
+    PrimaryActorTick.bCanEverTick = true;
     CommandName = TEXT("FactorySpawner");
-    MinNumberOfArguments = 2;
+    MinNumberOfArguments = 1;
     Usage = FText::FromString("Usage: /FactorySpawner <number> <machine type 1> <recipe 1>, <number> <machine type 2> "
-                              "<recipe 2>, beltTier <number>");
+                              "<recipe 2>, power <poles|wall|chain>, beltTier <number> | "
+                              "/FactorySpawner file <plan file> | /FactorySpawner save <name> <command> | "
+                              "/FactorySpawner load <name> | /FactorySpawner diff | /FactorySpawner dryrun <command> | "
+                              "/FactorySpawner place [rotate <degrees>] [force] <command> | "
+                              "/FactorySpawner status | queue | cancel [job number|all]");
 }
 
 EExecutionStatus AFactorySpawnerChat::ExecuteCommand_Implementation(UCommandSender* Sender,
                                                                     const TArray<FString>& Arguments,
                                                                     const FString& Label)
 {
+    FFactorySpawnerModule::FScopedChatTarget ChatTarget(Sender);
     FString Joined = FString::Join(Arguments, TEXT(" "));
     Sender->SendChatMessage(FString::Printf(TEXT("/FactorySpawner %s"), *Joined), FLinearColor::Green);
 
+    if (Arguments[0].Equals(TEXT("diff"), ESearchCase::IgnoreCase))
+        return ExecuteDiffCommand(Sender);
+    if (Arguments[0].Equals(TEXT("status"), ESearchCase::IgnoreCase))
+        return ExecuteStatusCommand(Sender, false);
+    if (Arguments[0].Equals(TEXT("queue"), ESearchCase::IgnoreCase))
+        return ExecuteStatusCommand(Sender, true);
+    if (Arguments[0].Equals(TEXT("cancel"), ESearchCase::IgnoreCase))
+        return ExecuteCancelCommand(Sender, Arguments.Num() > 1 ? Arguments[1] : FString());
+    if (Arguments.Num() < 2)
+    {
+        Sender->SendChatMessage(Usage.ToString());
+        return EExecutionStatus::BAD_ARGUMENTS;
+    }
+
+    if (Arguments[0].Equals(TEXT("file"), ESearchCase::IgnoreCase))
+        return ExecuteFileCommand(Sender, Arguments[1]);
+    if (Arguments[0].Equals(TEXT("load"), ESearchCase::IgnoreCase))
+        return ExecuteLoadCommand(Sender, Arguments[1]);
+
+    // save <name> <command>: generate as usual and keep the plan
+    FString SaveName;
+    if (Arguments[0].Equals(TEXT("save"), ESearchCase::IgnoreCase))
+    {
+        SaveName = Arguments[1];
+        Joined = FString::Join(TArrayView<const FString>(Arguments).RightChop(2), TEXT(" "));
+    }
+
+    // dryrun <command>: plan only and report what would be built
+    const bool bDryRun = Arguments[0].Equals(TEXT("dryrun"), ESearchCase::IgnoreCase);
+    if (bDryRun)
+        Joined = FString::Join(TArrayView<const FString>(Arguments).RightChop(1), TEXT(" "));
+
+    // place [rotate <degrees>] [force] <command>: build at the aim point instead of into the blueprint
+    TOptional<FTransform> Placement;
+    bool bForcePlacement = false;
+    if (Arguments[0].Equals(TEXT("place"), ESearchCase::IgnoreCase))
+    {
+        int32 CommandStart = 1;
+        TOptional<float> Yaw;
+        if (Arguments[1].Equals(TEXT("rotate"), ESearchCase::IgnoreCase))
+        {
+            if (Arguments.Num() < 4 || !Arguments[2].IsNumeric())
+            {
+                Sender->SendChatMessage(TEXT("Usage: /FactorySpawner place [rotate <degrees>] [force] <command>"));
+                return EExecutionStatus::BAD_ARGUMENTS;
+            }
+            Yaw = FCString::Atof(*Arguments[2]);
+            CommandStart = 3;
+        }
+        if (Arguments.IsValidIndex(CommandStart) &&
+            Arguments[CommandStart].Equals(TEXT("force"), ESearchCase::IgnoreCase))
+        {
+            bForcePlacement = true;
+            ++CommandStart;
+        }
+
+        FTransform Transform;
+        if (!GetAimPlacement(Sender, Yaw, Transform))
+        {
+            Sender->SendChatMessage(TEXT("Aim at the ground within 100 m to place a factory"));
+            return EExecutionStatus::BAD_ARGUMENTS;
+        }
+        Placement = Transform;
+        Joined = FString::Join(TArrayView<const FString>(Arguments).RightChop(CommandStart), TEXT(" "));
+    }
+
+    FCommandRecord Record(bDryRun ? TEXT("dryrun") : Placement.IsSet() ? TEXT("place") : TEXT("command"), Joined);
     TArray<FFactoryCommandToken> CommandTokens;
     FString Error;
     if (!FFactoryCommandParser::ParseCommand(Joined, CommandTokens, Error))
@@ -70,22 +177,503 @@ EExecutionStatus AFactorySpawnerChat::ExecuteCommand_Implementation(UCommandSend
         Sender->SendChatMessage(Error);
         return EExecutionStatus::BAD_ARGUMENTS;
     }
+    Record.EndPhase(Record.ParseMs);
 
-    UWorld* World = GetWorld();
+    TSet<FRecipeRequest> Recipes;
+    for (const FFactoryCommandToken& Row : CommandTokens)
+        AddRecipeRequest(Row, Recipes);
+    if (!ResolveRecipes(Sender, Recipes))
+        return EExecutionStatus::BAD_ARGUMENTS;
+    Record.EndPhase(Record.RecipesMs);
+
+    SetupTiers(Sender, CommandTokens.Num() > 0 ? CommandTokens[0].BeltTier : TOptional<int32>());
 
-    // Determine belt tier to use
-    int32 BeltTier = 1;
-    if (CommandTokens.Num() > 0 && CommandTokens[0].BeltTier.IsSet())
+    FBuildPlanGenerator Generator(GetWorld(), BuildableCache);
+    Generator.Generate(CommandTokens);
+
+    if (bDryRun)
+    {
+        Record.EndPhase(Record.PlanMs);
+        Record.SetPlan(Generator.GetPlan().GetView());
+        FCommandHistory::Append(Record, TEXT("dryrun"));
+
+        FPlanStatistics Stats = FPlanStatistics::Compute(Generator.GetPlan().GetView(), BuildableCache);
+        Stats.ComputeBuildCost(BuildableCache, GetWorld());
+        Sender->SendChatMessage(FString::Printf(TEXT("Dry run: %d buildables, %d connections, nothing spawned"),
+                                                Generator.GetPlan().Buildables.Num(),
+                                                Generator.GetPlan().Connections.Num()));
+        for (const FString& Line : Stats.GetReport())
+            Sender->SendChatMessage(Line, FLinearColor::Gray);
+        return EExecutionStatus::COMPLETED;
+    }
+
+    if (Placement.IsSet() && !bForcePlacement &&
+        !ClearPlacement(Sender, Generator.GetPlan().GetView(), Placement.GetValue()))
+        return EExecutionStatus::BAD_ARGUMENTS;
+    Record.EndPhase(Record.PlanMs);
+
+    if (!SaveName.IsEmpty())
+        SavePlan(Sender, SaveName, Generator.GetPlan());
+    SpawnPlan(Sender, MakeShared<const FSharedBuildPlan>(Generator.TakePlan()), MoveTemp(Record), Placement,
+              bForcePlacement);
+    return EExecutionStatus::COMPLETED;
+}
+
+EExecutionStatus AFactorySpawnerChat::ExecuteFileCommand(UCommandSender* Sender, const FString& Name)
+{
+    const FString Path = FPlanFileReader::FindPlanFile(Name);
+    if (Path.IsEmpty())
     {
-        // Use explicitly provided belt tier from inline parameter
-        BeltTier = CommandTokens[0].BeltTier.GetValue();
+        Sender->SendChatMessage(
+            FString::Printf(TEXT("Plan file '%s' not found in Saved/FactorySpawner or Config/FactorySpawner"), *Name));
+        return EExecutionStatus::BAD_ARGUMENTS;
     }
-    else
+
+    // First pass: only the distinct recipes and the record counts are kept, so that every bad recipe is reported
+    // before the layout and the plan is allocated once
+    FCommandRecord Record(TEXT("file"), Name);
+    FString Error;
+    TSet<FRecipeRequest> Recipes;
+    FPlanCapacity Capacity;
+    if (!FPlanFileReader::ReadFile(
+            Path,
+            [&](const FFactoryCommandToken& Row, FString& OutError)
+            {
+                AddRecipeRequest(Row, Recipes);
+                FBuildPlanGenerator::AddCapacity(Row, BuildableCache, Capacity);
+                return true;
+            },
+            Error))
     {
-        // Auto-detect highest unlocked belt tier
-        BeltTier = BuildableCache->GetHighestUnlockedBeltTier(World);
+        UE_LOG(LogFactorySpawner, Warning, TEXT("%s: %s"), *Path, *Error);
+        Sender->SendChatMessage(Error);
+        return EExecutionStatus::BAD_ARGUMENTS;
+    }
+    Record.EndPhase(Record.ParseMs);
+    if (!ResolveRecipes(Sender, Recipes))
+        return EExecutionStatus::BAD_ARGUMENTS;
+    Record.EndPhase(Record.RecipesMs);
+
+    // Second pass: rows are laid out while the file is read, the rows are never held in memory
+    FBuildPlanGenerator Generator(GetWorld(), BuildableCache);
+    const bool bOk = FPlanFileReader::ReadFile(
+        Path,
+        [&](const FFactoryCommandToken& Row, FString& OutError)
+        {
+            if (Generator.GetNumRows() == 0)
+            {
+                SetupTiers(Sender, Row.BeltTier);
+                Generator.Begin(Capacity);
+            }
+            Generator.AddRow(Row);
+            return true;
+        },
+        Error);
+
+    if (!bOk || Generator.GetNumRows() == 0)
+    {
+        if (Error.IsEmpty())
+            Error = TEXT("Plan file contains no rows");
+        UE_LOG(LogFactorySpawner, Warning, TEXT("%s: %s"), *Path, *Error);
+        Sender->SendChatMessage(FString::Printf(TEXT("%s (after %d rows)"), *Error, Generator.GetNumRows()));
+        Generator.Abort();
+        return EExecutionStatus::BAD_ARGUMENTS;
     }
 
+    Sender->SendChatMessage(FString::Printf(TEXT("Read %d rows from %s"), Generator.GetNumRows(), *Name),
+                            FLinearColor::Gray);
+    Generator.Finish();
+    Record.EndPhase(Record.PlanMs);
+    SpawnPlan(Sender, MakeShared<const FSharedBuildPlan>(Generator.TakePlan()), MoveTemp(Record));
+    return EExecutionStatus::COMPLETED;
+}
+
+EExecutionStatus AFactorySpawnerChat::ExecuteLoadCommand(UCommandSender* Sender, const FString& Name)
+{
+    FCommandRecord Record(TEXT("load"), Name);
+    const FString Path = FBuildPlan::GetSavePath(Name);
+    FString Error = FString::Printf(TEXT("Invalid plan name '%s'"), *Name);
+    TUniquePtr<FMappedBuildPlan> Plan = Path.IsEmpty() ? nullptr : FMappedBuildPlan::Open(Path, Error);
+    if (!Plan)
+    {
+        UE_LOG(LogFactorySpawner, Warning, TEXT("%s"), *Error);
+        Sender->SendChatMessage(Error);
+        return EExecutionStatus::BAD_ARGUMENTS;
+    }
+
+    // Tiers of belts and pipes are part of the plan, the rest is only needed to load the classes
+    SetupTiers(Sender, TOptional<int32>());
+
+    const FBuildPlanView View = Plan->GetView();
+    Sender->SendChatMessage(FString::Printf(TEXT("Loaded plan %s: %d buildables, %d connections"), *Name,
+                                            View.Buildables.Num(), View.Connections.Num()),
+                            FLinearColor::Gray);
+    Record.EndPhase(Record.ParseMs);
+
+    // The file stays mapped while the job spawns from it and while it is kept for diff
+    SpawnPlan(Sender, MakeShared<const FSharedBuildPlan>(MoveTemp(Plan)), MoveTemp(Record));
+    return EExecutionStatus::COMPLETED;
+}
+
+EExecutionStatus AFactorySpawnerChat::ExecuteDiffCommand(UCommandSender* Sender)
+{
+    const TArray<TSharedRef<const FSharedBuildPlan>>* Plans = RecentPlans.Find(Sender->GetSenderName());
+    if (!Plans || Plans->Num() < 2)
+    {
+        Sender->SendChatMessage(TEXT("Spawn two factories first, diff compares the last two plans"));
+        return EExecutionStatus::BAD_ARGUMENTS;
+    }
+
+    const TArray<FString> Lines = FPlanDiff::Compare((*Plans)[0]->GetView(), (*Plans)[1]->GetView());
+    if (Lines.IsEmpty())
+        Sender->SendChatMessage(TEXT("The last two plans are identical"), FLinearColor::Gray);
+    for (const FString& Line : Lines)
+        Sender->SendChatMessage(Line, FLinearColor::Gray);
+    return EExecutionStatus::COMPLETED;
+}
+
+EExecutionStatus AFactorySpawnerChat::ExecuteStatusCommand(UCommandSender* Sender, bool bAllPlayers)
+{
+    const FString Owner = Sender->GetSenderName();
+    TSet<FString> RunningOwners;
+    int32 NumListed = 0;
+    for (const TUniquePtr<FSpawnJob>& Job : Jobs)
+    {
+        // Only the first job of each player is worked on, the others wait for it
+        bool bAlreadyRunning = false;
+        RunningOwners.Add(Job->Owner, &bAlreadyRunning);
+        if (!bAllPlayers && Job->Owner != Owner)
+            continue;
+
+        Sender->SendChatMessage(FString::Printf(TEXT("#%d %s: %s, %.0f%% of %d records, %.1f s"), Job->Id,
+                                                *Job->Owner, bAlreadyRunning ? TEXT("waiting") : TEXT("running"),
+                                                Job->Spawner->GetProgress() * 100.0f, Job->Spawner->GetNumRecords(),
+                                                FPlatformTime::Seconds() - Job->StartTime),
+                                FLinearColor::Gray);
+        ++NumListed;
+    }
+
+    if (NumListed == 0)
+        Sender->SendChatMessage(bAllPlayers ? TEXT("No jobs") : TEXT("You have no jobs"), FLinearColor::Gray);
+    return EExecutionStatus::COMPLETED;
+}
+
+EExecutionStatus AFactorySpawnerChat::ExecuteCancelCommand(UCommandSender* Sender, const FString& Which)
+{
+    const FString Owner = Sender->GetSenderName();
+    const bool bAdmin = IsAdmin(Sender);
+    const bool bAll = Which.Equals(TEXT("all"), ESearchCase::IgnoreCase);
+    const int32 Id = Which.IsNumeric() ? FCString::Atoi(*Which) : 0;
+    if (!Which.IsEmpty() && !bAll && Id <= 0)
+    {
+        Sender->SendChatMessage(TEXT("Usage: /FactorySpawner cancel [job number|all]"));
+        return EExecutionStatus::BAD_ARGUMENTS;
+    }
+
+    // Without an argument the sender's newest job; "all" means every job for the host, the own jobs otherwise
+    TArray<int32> ToCancel;
+    for (int32 i = Jobs.Num() - 1; i >= 0; --i)
+    {
+        const FSpawnJob& Job = *Jobs[i];
+        if (Id > 0 ? Job.Id == Id : (Job.Owner == Owner || (bAll && bAdmin)))
+        {
+            ToCancel.Add(i);
+            if (Which.IsEmpty() || Id > 0)
+                break;
+        }
+    }
+
+    if (ToCancel.IsEmpty())
+    {
+        Sender->SendChatMessage(Id > 0 ? FString::Printf(TEXT("Job #%d not found"), Id) : TEXT("You have no jobs"));
+        return EExecutionStatus::BAD_ARGUMENTS;
+    }
+    if (Id > 0 && Jobs[ToCancel[0]]->Owner != Owner && !bAdmin)
+    {
+        Sender->SendChatMessage(FString::Printf(TEXT("Job #%d belongs to %s, only the host can cancel it"), Id,
+                                                *Jobs[ToCancel[0]]->Owner));
+        return EExecutionStatus::INSUFFICIENT_PERMISSIONS;
+    }
+
+    // Indices are in descending order, removing does not shift the remaining ones
+    for (int32 Index : ToCancel)
+    {
+        FSpawnJob& Job = *Jobs[Index];
+        Job.Spawner->Cancel();
+        RecordJob(Job, TEXT("cancelled"));
+        const FString Message =
+            Job.Spawner->IsPlacing()
+                ? FString::Printf(TEXT("Job #%d cancelled, placed buildables removed"), Job.Id)
+                : FString::Printf(TEXT("Job #%d cancelled, blueprint '%s' unchanged"), Job.Id,
+                                  *Job.Spawner->GetBlueprintName());
+        Sender->SendChatMessage(Message, FLinearColor::Gray);
+        if (Job.Owner != Owner && Job.Sender.IsValid())
+            Job.Sender->SendChatMessage(FString::Printf(TEXT("%s (by %s)"), *Message, *Owner));
+        Jobs.RemoveAt(Index);
+    }
+
+    for (auto It = LastServed.CreateIterator(); It; ++It)
+    {
+        const FString& Player = It.Key();
+        if (!Jobs.ContainsByPredicate([&](const TUniquePtr<FSpawnJob>& Job) { return Job->Owner == Player; }))
+            It.RemoveCurrent();
+    }
+    if (Jobs.IsEmpty())
+        GetWorldTimerManager().SetTimer(DrainPoolTimer, BuildableCache, &UBuildableCache::DrainPool,
+                                        PoolIdleSeconds);
+    return EExecutionStatus::COMPLETED;
+}
+
+bool AFactorySpawnerChat::IsAdmin(UCommandSender* Sender)
+{
+    if (!Sender->IsPlayerSender())
+        return true;
+    const AFGPlayerController* PC = Sender->GetPlayer();
+    return PC && PC->IsLocalController();
+}
+
+bool AFactorySpawnerChat::GetAimPlacement(UCommandSender* Sender, const TOptional<float>& Yaw,
+                                          FTransform& OutPlacement)
+{
+    AFGPlayerController* PC = Sender->IsPlayerSender() ? Sender->GetPlayer() : nullptr;
+    if (!PC || !PC->GetPawn())
+        return false;
+
+    FVector ViewLocation;
+    FRotator ViewRotation;
+    PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+    FHitResult Hit;
+    const FVector TraceEnd = ViewLocation + ViewRotation.Vector() * MaxPlaceDistance;
+    FCollisionQueryParams Params(SCENE_QUERY_STAT(FactorySpawnerPlace), false, PC->GetPawn());
+    if (!GetWorld()->LineTraceSingleByChannel(Hit, ViewLocation, TraceEnd, ECC_Visibility, Params))
+        return false;
+
+    const float PlaceYaw = Yaw.IsSet() ? Yaw.GetValue() : FMath::GridSnap(ViewRotation.Yaw, 90.0f);
+    const FVector Location(FMath::GridSnap(Hit.ImpactPoint.X, 100.0f), FMath::GridSnap(Hit.ImpactPoint.Y, 100.0f),
+                           Hit.ImpactPoint.Z);
+    OutPlacement = FTransform(FRotator(0.0f, PlaceYaw, 0.0f), Location);
+    return true;
+}
+
+bool AFactorySpawnerChat::ClearPlacement(UCommandSender* Sender, const FBuildPlanView& Plan,
+                                         FTransform& InOutPlacement)
+{
+    FPlanClearance Clearance(GetWorld(), BuildableCache, Plan);
+    TArray<FClearanceConflict> Conflicts;
+    if (Clearance.Check(InOutPlacement, &Conflicts))
+        return true;
+
+    FTransform Shifted;
+    if (Clearance.FindClearPlacement(InOutPlacement, MaxClearanceShift, Shifted))
+    {
+        Sender->SendChatMessage(
+            FString::Printf(TEXT("%d buildables would overlap existing structures, moved the factory by %.0f m"),
+                            Conflicts.Num(),
+                            FVector::Dist2D(InOutPlacement.GetLocation(), Shifted.GetLocation()) / 100.0f));
+        InOutPlacement = Shifted;
+        return true;
+    }
+
+    Sender->SendChatMessage(
+        FString::Printf(TEXT("%d buildables would overlap existing structures, no free spot within %.0f m:"),
+                        Conflicts.Num(), MaxClearanceShift * FPlanClearance::CellSize / 100.0f));
+    for (int32 i = 0; i < FMath::Min(Conflicts.Num(), MaxReportedConflicts); ++i)
+    {
+        const FPlannedBuildable& Buildable = Plan.Buildables[Conflicts[i].Buildable];
+        const FString Row = Buildable.Row == INDEX_NONE ? FString(TEXT("shared"))
+                                                         : FString::Printf(TEXT("row %d"), Buildable.Row + 1);
+        Sender->SendChatMessage(FString::Printf(TEXT("%s (%s) at %.0f, %.0f m: %s"),
+                                                *StaticEnum<EBuildable>()->GetNameStringByValue((int64) Buildable.Type),
+                                                *Row, Buildable.Location.X / 100.0f, Buildable.Location.Y / 100.0f,
+                                                *Conflicts[i].Obstacle),
+                                FLinearColor::Gray);
+    }
+    if (Conflicts.Num() > MaxReportedConflicts)
+        Sender->SendChatMessage(FString::Printf(TEXT("... and %d more"), Conflicts.Num() - MaxReportedConflicts),
+                                FLinearColor::Gray);
+    Sender->SendChatMessage(TEXT("Aim somewhere else, or use 'place force' to build anyway"));
+    return false;
+}
+
+void AFactorySpawnerChat::SpawnPlan(UCommandSender* Sender, const TSharedRef<const FSharedBuildPlan>& Plan,
+                                    FCommandRecord&& Record, const TOptional<FTransform>& Placement,
+                                    bool bForcePlacement)
+{
+    const FBuildPlanView View = Plan->GetView();
+
+    // Every remote player gets an own blueprint, the host keeps the plain name
+    const FString Owner = Sender->GetSenderName();
+    AFGPlayerController* PC = Sender->IsPlayerSender() ? Sender->GetPlayer() : nullptr;
+    const FString BlueprintName =
+        PC && !PC->IsLocalController() ? FString::Printf(TEXT("FactorySpawner %s"), *Owner) : TEXT("FactorySpawner");
+
+    TUniquePtr<FSpawnJob>& Job = Jobs.Add_GetRef(MakeUnique<FSpawnJob>());
+    Job->Id = NextJobId++;
+    Job->Owner = Owner;
+    Job->Sender.Reset(Sender);
+    Job->Spawner = MakeUnique<FBuildPlanSpawner>(GetWorld(), BuildableCache, PC, BlueprintName);
+    if (Placement.IsSet())
+        Job->Spawner->SetPlacement(Placement.GetValue());
+    Job->bCheckPlacement = Placement.IsSet() && !bForcePlacement;
+    Job->Spawner->Begin(Plan);
+    Job->StartTime = FPlatformTime::Seconds();
+    Job->Record = MoveTemp(Record);
+    Job->Record.SetPlan(View);
+    if (Jobs.Num() > 1)
+        Sender->SendChatMessage(FString::Printf(TEXT("Job #%d queued, %d jobs ahead"), Job->Id, Jobs.Num() - 1),
+                                FLinearColor::Gray);
+
+    const uint64 Hash = FPlanDiff::GetHash(View);
+    TArray<TSharedRef<const FSharedBuildPlan>>& Plans = RecentPlans.FindOrAdd(Owner);
+    const bool bUnchanged = Plans.Num() > 0 && FPlanDiff::GetHash(Plans.Last()->GetView()) == Hash;
+    Sender->SendChatMessage(FString::Printf(TEXT("Plan hash: %016llx%s"), Hash,
+                                            bUnchanged ? TEXT(" (unchanged)") : TEXT("")),
+                            FLinearColor::Gray);
+
+    // Keep the last two plans for diff
+    if (Plans.Num() == 2)
+        Plans.RemoveAt(0);
+    Plans.Add(Plan);
+}
+
+void AFactorySpawnerChat::Tick(float DeltaSeconds)
+{
+    Super::Tick(DeltaSeconds);
+
+    if (Jobs.Num() > 0)
+        StepJobs();
+}
+
+void AFactorySpawnerChat::StepJobs()
+{
+    // The first job of every player is a candidate, the player who waited longest goes first
+    int32 JobIndex = INDEX_NONE;
+    double OldestServed = MAX_dbl;
+    TArray<FString, TInlineAllocator<8>> Owners;
+    for (int32 i = 0; i < Jobs.Num(); ++i)
+    {
+        if (Owners.Contains(Jobs[i]->Owner))
+            continue;
+        Owners.Add(Jobs[i]->Owner);
+
+        const double Served = LastServed.FindRef(Jobs[i]->Owner);
+        if (Served < OldestServed)
+        {
+            OldestServed = Served;
+            JobIndex = i;
+        }
+    }
+
+    FSpawnJob& Job = *Jobs[JobIndex];
+    const double Now = FPlatformTime::Seconds();
+    LastServed.Add(Job.Owner, Now);
+
+    // Jobs ahead of this one may have built on the spot since the command was typed
+    if (Job.bCheckPlacement)
+    {
+        Job.bCheckPlacement = false;
+        FTransform Placement = Job.Spawner->GetPlacement();
+        if (Job.Sender.IsValid() && !ClearPlacement(Job.Sender.Get(), Job.Spawner->GetPlan(), Placement))
+        {
+            Job.Sender->SendChatMessage(FString::Printf(TEXT("Job #%d not started"), Job.Id), FLinearColor::Gray);
+            FinishJob(JobIndex, TEXT("blocked"));
+            return;
+        }
+        Job.Spawner->SetPlacement(Placement);
+    }
+
+    const bool bDone = Job.Spawner->Step(Now + SpawnBudgetSeconds);
+    Job.Record.SampleMemory();
+    if (!bDone)
+    {
+        // Progress in quarters, only to the player who issued the command
+        const int32 Quarters = FMath::FloorToInt(Job.Spawner->GetProgress() * 4.0f);
+        if (Quarters > Job.ReportedQuarters && Job.Sender.IsValid())
+        {
+            Job.ReportedQuarters = Quarters;
+            Job.Sender->SendChatMessage(FString::Printf(TEXT("Job #%d: %d%%"), Job.Id, Quarters * 25),
+                                        FLinearColor::Gray);
+        }
+        return;
+    }
+
+    if (Job.Sender.IsValid() && Job.Spawner->IsPlacing())
+        Job.Sender->SendChatMessage(FString::Printf(TEXT("Factory placed: %d records in %.1f s"),
+                                                    Job.Spawner->GetNumRecords(),
+                                                    FPlatformTime::Seconds() - Job.StartTime));
+    else if (Job.Sender.IsValid())
+        Job.Sender->SendChatMessage(FString::Printf(TEXT("Blueprint '%s' ready: %d records in %.1f s"),
+                                                    *Job.Spawner->GetBlueprintName(), Job.Spawner->GetNumRecords(),
+                                                    FPlatformTime::Seconds() - Job.StartTime));
+
+    FinishJob(JobIndex, TEXT("done"));
+}
+
+void AFactorySpawnerChat::FinishJob(int32 JobIndex, const TCHAR* Result)
+{
+    RecordJob(*Jobs[JobIndex], Result);
+    const FString Owner = Jobs[JobIndex]->Owner;
+    Jobs.RemoveAt(JobIndex);
+    if (!Jobs.ContainsByPredicate([&](const TUniquePtr<FSpawnJob>& Other) { return Other->Owner == Owner; }))
+        LastServed.Remove(Owner);
+
+    if (Jobs.IsEmpty())
+        GetWorldTimerManager().SetTimer(DrainPoolTimer, BuildableCache, &UBuildableCache::DrainPool,
+                                        PoolIdleSeconds);
+}
+
+void AFactorySpawnerChat::RecordJob(FSpawnJob& Job, const TCHAR* Result)
+{
+    const FBuildPlanSpawner::FTimings& Timings = Job.Spawner->GetTimings();
+    Job.Record.SpawnMs = Timings.Spawn * 1000.0;
+    Job.Record.BlueprintMs = Timings.Blueprint * 1000.0;
+    Job.Record.DestroyMs = Timings.Destroy * 1000.0;
+    FCommandHistory::Append(Job.Record, Result);
+}
+
+void AFactorySpawnerChat::SavePlan(UCommandSender* Sender, const FString& Name, const FBuildPlan& Plan)
+{
+    const FString Path = FBuildPlan::GetSavePath(Name);
+    FString Error = FString::Printf(TEXT("Invalid plan name '%s'"), *Name);
+    if (Path.IsEmpty() || !Plan.SaveToFile(Path, Error))
+    {
+        UE_LOG(LogFactorySpawner, Warning, TEXT("%s"), *Error);
+        Sender->SendChatMessage(Error);
+        return;
+    }
+    Sender->SendChatMessage(FString::Printf(TEXT("Saved plan as %s, spawn it again with /FactorySpawner load %s"),
+                                            *Name, *Name),
+                            FLinearColor::Gray);
+}
+
+void AFactorySpawnerChat::AddRecipeRequest(const FFactoryCommandToken& Row, TSet<FRecipeRequest>& InOutRecipes)
+{
+    if (Row.Recipe.IsSet())
+        InOutRecipes.Add({Row.MachineType, Row.Recipe.GetValue(), Row.MachineClass});
+}
+
+bool AFactorySpawnerChat::ResolveRecipes(UCommandSender* Sender, const TSet<FRecipeRequest>& Recipes)
+{
+    TArray<FString> Errors;
+    if (BuildableCache->ResolveRecipes(Recipes, GetWorld(), Errors))
+        return true;
+
+    for (const FString& Error : Errors)
+    {
+        UE_LOG(LogFactorySpawner, Warning, TEXT("%s"), *Error);
+        Sender->SendChatMessage(Error);
+    }
+    return false;
+}
+
+void AFactorySpawnerChat::SetupTiers(UCommandSender* Sender, const TOptional<int32>& BeltTierOverride)
+{
+    UWorld* World = GetWorld();
+
+    // Use explicitly provided belt tier, otherwise the highest unlocked one
+    const int32 BeltTier = BeltTierOverride.IsSet() ? BeltTierOverride.GetValue()
+                                                    : BuildableCache->GetHighestUnlockedBeltTier(World);
     BuildableCache->SetBeltClass(BeltTier);
     BuildableCache->SetLiftClass(BeltTier);
 
@@ -93,9 +681,11 @@ EExecutionStatus AFactorySpawnerChat::ExecuteCommand_Implementation(UCommandSend
     int32 PipelineTier = BuildableCache->GetHighestUnlockedPipelineTier(World);
     BuildableCache->SetPipelineClass(PipelineTier);
 
-    Sender->SendChatMessage(FString::Printf(TEXT("Using Belt Tier: Mk%d, Pipeline Tier: Mk%d"), BeltTier, PipelineTier),
-                            FLinearColor::Gray);
+    // Auto-detect power pole tier, the power planner picks the cheapest tier up to this one per pole
+    int32 PowerPoleTier = BuildableCache->GetHighestUnlockedPowerPoleTier(World);
+    BuildableCache->SetPowerPoleTier(PowerPoleTier);
 
-    FBuildPlanGenerator(World, BuildableCache).Generate(CommandTokens);
-    return EExecutionStatus::COMPLETED;
+    Sender->SendChatMessage(FString::Printf(TEXT("Using Belt Tier: Mk%d, Pipeline Tier: Mk%d, Power Poles: up to Mk%d"),
+                                            BeltTier, PipelineTier, PowerPoleTier),
+                            FLinearColor::Gray);
 }
@@ -0,0 +1,81 @@
+#include "GeneratorFuel.h"
+
+namespace
+{
+    // Rates per generator at 100%, derived from the fuel energy values and the generator output
+    const TArray<FGeneratorFuel> FuelList = {
+        {TEXT("Coal"), EBuildable::CoalGenerator, false, 15.0f, 45.0f},
+        {TEXT("CompactedCoal"), EBuildable::CoalGenerator, false, 7.142857f, 45.0f},
+        {TEXT("PetroleumCoke"), EBuildable::CoalGenerator, false, 25.0f, 45.0f},
+        {TEXT("Fuel"), EBuildable::FuelGenerator, true, 20.0f},
+        {TEXT("LiquidBiofuel"), EBuildable::FuelGenerator, true, 20.0f},
+        {TEXT("Turbofuel"), EBuildable::FuelGenerator, true, 7.5f},
+        {TEXT("RocketFuel"), EBuildable::FuelGenerator, true, 4.166667f},
+        {TEXT("IonizedFuel"), EBuildable::FuelGenerator, true, 3.0f},
+        {TEXT("UraniumFuelRod"), EBuildable::NuclearReactor, false, 0.2f, 240.0f, 10.0f},
+        {TEXT("PlutoniumFuelRod"), EBuildable::NuclearReactor, false, 0.1f, 240.0f, 1.0f},
+        {TEXT("FicsoniumFuelRod"), EBuildable::NuclearReactor, false, 1.0f, 240.0f, 0.0f}};
+
+    // Alternative spellings, e.g. the display names of the items
+    const TMap<FString, FString> FuelAliases = {{TEXT("liquidfuel"), TEXT("Fuel")},
+                                                {TEXT("biofuel"), TEXT("LiquidBiofuel")},
+                                                {TEXT("petcoke"), TEXT("PetroleumCoke")},
+                                                {TEXT("nuclearfuelrod"), TEXT("UraniumFuelRod")},
+                                                {TEXT("uraniumrod"), TEXT("UraniumFuelRod")},
+                                                {TEXT("plutoniumrod"), TEXT("PlutoniumFuelRod")},
+                                                {TEXT("ficsoniumrod"), TEXT("FicsoniumFuelRod")}};
+} // namespace
+
+float FGeneratorFuels::GetPowerOutput(EBuildable Generator)
+{
+    switch (Generator)
+    {
+    case EBuildable::CoalGenerator:
+        return 75.0f;
+    case EBuildable::FuelGenerator:
+        return 250.0f;
+    case EBuildable::NuclearReactor:
+        return 2500.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+const FGeneratorFuel* FGeneratorFuels::Find(EBuildable Generator, const FString& Fuel)
+{
+    const FString* Alias = FuelAliases.Find(Fuel.ToLower());
+    const FString& Name = Alias ? *Alias : Fuel;
+
+    return FuelList.FindByPredicate(
+        [&](const FGeneratorFuel& Item)
+        { return Item.Generator == Generator && Item.Name.Equals(Name, ESearchCase::IgnoreCase); });
+}
+
+TArray<FString> FGeneratorFuels::GetFuelNames(EBuildable Generator)
+{
+    TArray<FString> Names;
+    for (const FGeneratorFuel& Item : FuelList)
+    {
+        if (Item.Generator == Generator)
+            Names.Add(Item.Name);
+    }
+    return Names;
+}
+
+FGeneratorRowEstimate FGeneratorFuels::Estimate(EBuildable Generator, const FGeneratorFuel* Fuel, int32 Count,
+                                                float ClockPercent)
+{
+    const float Clock = ClockPercent / 100.0f;
+
+    FGeneratorRowEstimate Estimate;
+    Estimate.Fuel = Fuel;
+    Estimate.Count = Count;
+    Estimate.PowerOutput = GetPowerOutput(Generator) * Clock * Count;
+    if (Fuel)
+    {
+        Estimate.FuelPerMinute = Fuel->FuelPerMinute * Clock * Count;
+        Estimate.WaterPerMinute = Fuel->WaterPerMinute * Clock * Count;
+        Estimate.WastePerMinute = Fuel->WastePerMinute * Clock * Count;
+    }
+    return Estimate;
+}
@@ -0,0 +1,223 @@
+#include "PlanClearance.h"
+#include "BuildableCache.h"
+#include "Buildables/FGBuildable.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/OverlapResult.h"
+#include "Engine/World.h"
+#include "InstancedFoliageActor.h"
+
+namespace
+{
+    // Footprints are shrunk a bit, so buildables flush with a wall or standing on a foundation are no conflict
+    constexpr float Margin = 10.0f;
+
+    // Machine heights are not part of FMachineConfig, the check covers the lower floor of a factory
+    constexpr float MachineHeight = 800.0f;
+    constexpr float AttachmentExtent = 100.0f - Margin;
+    constexpr float PoleExtent = 50.0f - Margin;
+    constexpr float PoleHeight = 700.0f;
+    const FVector WallExtent(25.0f - Margin, 400.0f - Margin, 400.0f);
+
+    FIntPoint GetCell(const FVector& Location)
+    {
+        return FIntPoint(FMath::FloorToInt32(Location.X / FPlanClearance::CellSize),
+                         FMath::FloorToInt32(Location.Y / FPlanClearance::CellSize));
+    }
+
+    FCollisionObjectQueryParams GetStructureObjectTypes()
+    {
+        FCollisionObjectQueryParams Params;
+        Params.AddObjectTypesToQuery(ECC_WorldStatic);
+        Params.AddObjectTypesToQuery(ECC_WorldDynamic);
+        return Params;
+    }
+} // namespace
+
+FPlanClearance::FPlanClearance(UWorld* InWorld, UBuildableCache* Cache, const FBuildPlanView& Plan) : World(InWorld)
+{
+    LocalBoxes.Reserve(Plan.Buildables.Num());
+    for (const FPlannedBuildable& Buildable : Plan.Buildables)
+        LocalBoxes.Add(GetLocalBox(Buildable, Plan.GetMachineClassPath(Buildable), Cache));
+}
+
+FBox FPlanClearance::GetLocalBox(const FPlannedBuildable& Buildable, const FString& MachineClass,
+                                 UBuildableCache* Cache)
+{
+    const FVector Location(Buildable.Location);
+    const FIntPoint Size = Cache->GetMachineSize(Buildable.Type, MachineClass);
+    if (Size != FIntPoint::ZeroValue)
+    {
+        const FVector Extent(Size.X * 50.0f - Margin, Size.Y * 50.0f - Margin, 0.0f);
+        return FBox(Location + FVector(-Extent.X, -Extent.Y, Margin),
+                    Location + FVector(Extent.X, Extent.Y, MachineHeight));
+    }
+
+    switch (Buildable.Type)
+    {
+    case EBuildable::Splitter:
+    case EBuildable::Merger:
+    case EBuildable::SmartSplitter:
+    case EBuildable::PipeCross:
+        return FBox(Location - FVector(AttachmentExtent), Location + FVector(AttachmentExtent));
+    case EBuildable::PowerPole:
+    case EBuildable::PowerPoleMk2:
+    case EBuildable::PowerPoleMk3:
+        return FBox(Location + FVector(-PoleExtent, -PoleExtent, Margin),
+                    Location + FVector(PoleExtent, PoleExtent, PoleHeight));
+    case EBuildable::PowerWallOutlet:
+        return FBox(Location - FVector(PoleExtent), Location + FVector(PoleExtent));
+    case EBuildable::Wall:
+        return FBox(Location + FVector(-WallExtent.X, -WallExtent.Y, Margin),
+                    Location + FVector(WallExtent.X, WallExtent.Y, WallExtent.Z));
+    default:
+        return FBox(ForceInit);
+    }
+}
+
+bool FPlanClearance::IsStructure(const FOverlapResult& Overlap, FString* OutName)
+{
+    const AActor* Actor = Overlap.GetActor();
+    if (!Actor)
+        return false;
+
+    if (Actor->IsA<AFGBuildable>())
+    {
+        if (OutName)
+        {
+            *OutName = Actor->GetClass()->GetName();
+            OutName->RemoveFromStart(TEXT("Build_"));
+            OutName->RemoveFromEnd(TEXT("_C"));
+        }
+        return true;
+    }
+
+    // Lightweight buildables (foundations, walls, beams) have no actor of their own, only mesh instances
+    const UInstancedStaticMeshComponent* Instances = Cast<UInstancedStaticMeshComponent>(Overlap.GetComponent());
+    if (!Instances || Actor->IsA<AInstancedFoliageActor>())
+        return false;
+    if (OutName)
+        *OutName = Instances->GetStaticMesh() ? Instances->GetStaticMesh()->GetName() : Actor->GetName();
+    return true;
+}
+
+bool FPlanClearance::IsCellBlocked(const FIntPoint& Cell, float MinZ, float MaxZ)
+{
+    if (const bool* bBlocked = BlockedCells.Find(Cell))
+        return *bBlocked;
+
+    const FVector Min(Cell.X * CellSize, Cell.Y * CellSize, MinZ);
+    const FVector Max = Min + FVector(CellSize, CellSize, MaxZ - MinZ);
+    const bool bBlocked = IsBoxBlocked(FBox(Min, Max), nullptr);
+    BlockedCells.Add(Cell, bBlocked);
+    return bBlocked;
+}
+
+bool FPlanClearance::IsBoxBlocked(const FBox& Box, FString* OutName)
+{
+    TArray<FOverlapResult> Overlaps;
+    FCollisionQueryParams Params(SCENE_QUERY_STAT(FactorySpawnerClearance), false);
+    World->OverlapMultiByObjectType(Overlaps, Box.GetCenter(), FQuat::Identity, GetStructureObjectTypes(),
+                                    FCollisionShape::MakeBox(Box.GetExtent()), Params);
+
+    for (const FOverlapResult& Overlap : Overlaps)
+    {
+        if (IsStructure(Overlap, OutName))
+            return true;
+    }
+    return false;
+}
+
+bool FPlanClearance::Check(const FTransform& Placement, TArray<FClearanceConflict>* OutConflicts)
+{
+    if (OutConflicts)
+        OutConflicts->Reset();
+
+    // World boxes hashed into every cell they touch
+    TArray<FBox> Boxes;
+    Boxes.Init(FBox(ForceInit), LocalBoxes.Num());
+    TMap<FIntPoint, TArray<int32, TInlineAllocator<8>>> Cells;
+    float MinZ = TNumericLimits<float>::Max();
+    float MaxZ = TNumericLimits<float>::Lowest();
+    for (int32 i = 0; i < LocalBoxes.Num(); ++i)
+    {
+        if (!LocalBoxes[i].IsValid)
+            continue;
+        const FBox& Box = Boxes[i] = LocalBoxes[i].TransformBy(Placement);
+        MinZ = FMath::Min<float>(MinZ, Box.Min.Z);
+        MaxZ = FMath::Max<float>(MaxZ, Box.Max.Z);
+
+        const FIntPoint First = GetCell(Box.Min);
+        const FIntPoint Last = GetCell(Box.Max);
+        for (int32 X = First.X; X <= Last.X; ++X)
+        {
+            for (int32 Y = First.Y; Y <= Last.Y; ++Y)
+                Cells.FindOrAdd(FIntPoint(X, Y)).Add(i);
+        }
+    }
+    if (Cells.IsEmpty())
+        return true;
+
+    // Shifted placements keep the height, so the cell results stay valid between them
+    const FVector2D ZRange(MinZ, MaxZ);
+    if (!ZRange.Equals(CachedZRange))
+    {
+        BlockedCells.Reset();
+        CachedZRange = ZRange;
+    }
+
+    // Only the buildables of blocked cells get a query of their own, each once even if it spans several cells
+    TBitArray<> Tested(false, Boxes.Num());
+    bool bClear = true;
+    for (const auto& Cell : Cells)
+    {
+        if (!IsCellBlocked(Cell.Key, MinZ, MaxZ))
+            continue;
+
+        for (int32 Index : Cell.Value)
+        {
+            if (Tested[Index])
+                continue;
+            Tested[Index] = true;
+
+            FString Obstacle;
+            if (!IsBoxBlocked(Boxes[Index], OutConflicts ? &Obstacle : nullptr))
+                continue;
+            if (!OutConflicts)
+                return false;
+            bClear = false;
+            OutConflicts->Add({Index, MoveTemp(Obstacle)});
+        }
+    }
+
+    if (OutConflicts)
+        OutConflicts->Sort([](const FClearanceConflict& A, const FClearanceConflict& B)
+                           { return A.Buildable < B.Buildable; });
+    return bClear;
+}
+
+bool FPlanClearance::FindClearPlacement(const FTransform& Placement, int32 MaxSteps, FTransform& OutPlacement)
+{
+    // Whole cells along the plan's axes, nearest first
+    TArray<FIntPoint> Offsets;
+    for (int32 X = -MaxSteps; X <= MaxSteps; ++X)
+    {
+        for (int32 Y = -MaxSteps; Y <= MaxSteps; ++Y)
+        {
+            if (X != 0 || Y != 0)
+                Offsets.Add(FIntPoint(X, Y));
+        }
+    }
+    Offsets.StableSort([](const FIntPoint& A, const FIntPoint& B) { return A.SizeSquared() < B.SizeSquared(); });
+
+    for (const FIntPoint& Offset : Offsets)
+    {
+        FTransform Shifted = Placement;
+        Shifted.AddToTranslation(Placement.GetRotation().RotateVector(FVector(Offset.X, Offset.Y, 0) * CellSize));
+        if (Check(Shifted))
+        {
+            OutPlacement = Shifted;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,218 @@
+#include "PlanDiff.h"
+#include "Hash/CityHash.h"
+
+namespace
+{
+    // Sortable identity of a buildable: locations in whole cm, clock and boost in thousandths
+    struct FBuildableKey
+    {
+        int32 Fields[10];
+
+        bool operator<(const FBuildableKey& Other) const
+        {
+            for (int32 i = 0; i < UE_ARRAY_COUNT(Fields); ++i)
+            {
+                if (Fields[i] != Other.Fields[i])
+                    return Fields[i] < Other.Fields[i];
+            }
+            return false;
+        }
+    };
+
+    uint32 GetRecipeHash(const FBuildPlanView& Plan, int32 Recipe)
+    {
+        return Plan.ClassPaths.IsValidIndex(Recipe) ? FCrc::StrCrc32(*Plan.ClassPaths[Recipe]) : 0;
+    }
+
+    FBuildableKey MakeKey(const FBuildPlanView& Plan, const FPlannedBuildable& Buildable)
+    {
+        return {{(int32) Buildable.Type, Buildable.Row, FMath::RoundToInt(Buildable.Location.X),
+                 FMath::RoundToInt(Buildable.Location.Y), FMath::RoundToInt(Buildable.Location.Z),
+                 (int32) Buildable.bFlipped, (int32) GetRecipeHash(Plan, Buildable.ClassPath),
+                 FMath::RoundToInt(Buildable.ClockPercent * 1000.0f),
+                 FMath::RoundToInt(Buildable.ProductionBoost * 1000.0f),
+                 (int32) GetRecipeHash(Plan, Buildable.MachineClass)}};
+    }
+
+    bool IsMachine(EBuildable Type)
+    {
+        return Type < EBuildable::Splitter;
+    }
+
+    // "/Game/.../Recipe_IngotIron.Recipe_IngotIron_C" -> "IngotIron"
+    FString GetRecipeName(const FBuildPlanView& Plan, int32 Recipe)
+    {
+        if (!Plan.ClassPaths.IsValidIndex(Recipe))
+            return TEXT("none");
+
+        FString Name = Plan.ClassPaths[Recipe];
+        Name.Split(TEXT("."), nullptr, &Name, ESearchCase::CaseSensitive, ESearchDir::FromEnd);
+        Name.RemoveFromStart(TEXT("Recipe_"));
+        Name.RemoveFromEnd(TEXT("_C"));
+        return Name;
+    }
+
+    FString GetTypeName(EBuildable Type)
+    {
+        return StaticEnum<EBuildable>()->GetNameStringByValue((int64) Type);
+    }
+
+    // What a row of machines looks like from the outside
+    struct FRowSummary
+    {
+        EBuildable Type = EBuildable::Invalid;
+        int32 Count = 0;
+        FString Recipe;
+        float ClockPercent = 100.0f;
+        FVector3f Origin = FVector3f::ZeroVector; // Location of the first machine
+    };
+
+    TArray<FRowSummary> GetRows(const FBuildPlanView& Plan)
+    {
+        TArray<FRowSummary> Rows;
+        for (const FPlannedBuildable& Buildable : Plan.Buildables)
+        {
+            if (!IsMachine(Buildable.Type) || Buildable.Row < 0)
+                continue;
+
+            if (Buildable.Row >= Rows.Num())
+                Rows.SetNum(Buildable.Row + 1);
+            FRowSummary& Row = Rows[Buildable.Row];
+            if (Row.Count++ == 0)
+            {
+                Row.Type = Buildable.Type;
+                Row.Recipe = GetRecipeName(Plan, Buildable.ClassPath);
+                Row.ClockPercent = Buildable.ClockPercent;
+                Row.Origin = Buildable.Location;
+            }
+        }
+        return Rows;
+    }
+
+    // "+4 Splitter, -2 PowerPole"
+    template <typename KeyType>
+    FString CompareCounts(const TMap<KeyType, int32>& Old, const TMap<KeyType, int32>& New,
+                          TFunctionRef<FString(KeyType)> GetName)
+    {
+        TArray<KeyType> Keys;
+        Old.GetKeys(Keys);
+        for (const TPair<KeyType, int32>& Pair : New)
+            Keys.AddUnique(Pair.Key);
+        Keys.Sort();
+
+        TArray<FString> Changes;
+        for (KeyType Key : Keys)
+        {
+            const int32 Delta = New.FindRef(Key) - Old.FindRef(Key);
+            if (Delta != 0)
+                Changes.Add(FString::Printf(TEXT("%s%d %s"), Delta > 0 ? TEXT("+") : TEXT(""), Delta, *GetName(Key)));
+        }
+        return FString::Join(Changes, TEXT(", "));
+    }
+} // namespace
+
+uint64 FPlanDiff::GetHash(const FBuildPlanView& Plan)
+{
+    TArray<int32> Order;
+    Order.SetNumUninitialized(Plan.Buildables.Num());
+    TArray<FBuildableKey> Keys;
+    Keys.Reserve(Plan.Buildables.Num());
+    for (int32 i = 0; i < Plan.Buildables.Num(); ++i)
+    {
+        Order[i] = i;
+        Keys.Add(MakeKey(Plan, Plan.Buildables[i]));
+    }
+    Order.Sort([&](int32 A, int32 B) { return Keys[A] < Keys[B]; });
+
+    // Connections refer to buildables by their sorted position
+    TArray<int32> Remap;
+    Remap.SetNumUninitialized(Order.Num());
+    for (int32 i = 0; i < Order.Num(); ++i)
+        Remap[Order[i]] = i;
+
+    // 24 bits per buildable index, 4 bits per port, type and tier
+    TArray<uint64> Connections;
+    Connections.Reserve(Plan.Connections.Num());
+    for (const FPlannedConnection& Connection : Plan.Connections)
+    {
+        Connections.Add((uint64) Remap[Connection.From] << 40 | (uint64) Remap[Connection.To] << 16 |
+                        (uint64) Connection.FromPort << 12 | (uint64) Connection.ToPort << 8 |
+                        (uint64) Connection.Type << 4 | Connection.Tier);
+    }
+    Connections.Sort();
+
+    uint64 Hash = 0;
+    for (int32 Index : Order)
+        Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Keys[Index].Fields), sizeof(FBuildableKey), Hash);
+    return CityHash64WithSeed(reinterpret_cast<const char*>(Connections.GetData()),
+                              Connections.Num() * sizeof(uint64), Hash);
+}
+
+TArray<FString> FPlanDiff::Compare(const FBuildPlanView& Old, const FBuildPlanView& New)
+{
+    TArray<FString> Lines;
+
+    TMap<EBuildable, int32> OldTypes, NewTypes;
+    for (const FPlannedBuildable& Buildable : Old.Buildables)
+        ++OldTypes.FindOrAdd(Buildable.Type);
+    for (const FPlannedBuildable& Buildable : New.Buildables)
+        ++NewTypes.FindOrAdd(Buildable.Type);
+    const FString Buildables = CompareCounts<EBuildable>(OldTypes, NewTypes, GetTypeName);
+    if (!Buildables.IsEmpty())
+        Lines.Add(TEXT("Buildables: ") + Buildables);
+
+    TMap<EPlannedLink, int32> OldLinks, NewLinks;
+    for (const FPlannedConnection& Connection : Old.Connections)
+        ++OldLinks.FindOrAdd(Connection.Type);
+    for (const FPlannedConnection& Connection : New.Connections)
+        ++NewLinks.FindOrAdd(Connection.Type);
+    const FString Connections = CompareCounts<EPlannedLink>(
+        OldLinks, NewLinks,
+        [](EPlannedLink Type)
+        {
+            return FString(Type == EPlannedLink::Belt   ? TEXT("belts")
+                           : Type == EPlannedLink::Pipe ? TEXT("pipes")
+                                                        : TEXT("power lines"));
+        });
+    if (!Connections.IsEmpty())
+        Lines.Add(TEXT("Connections: ") + Connections);
+
+    const TArray<FRowSummary> OldRows = GetRows(Old);
+    const TArray<FRowSummary> NewRows = GetRows(New);
+    for (int32 i = 0; i < FMath::Max(OldRows.Num(), NewRows.Num()); ++i)
+    {
+        const FRowSummary* OldRow = OldRows.IsValidIndex(i) && OldRows[i].Count > 0 ? &OldRows[i] : nullptr;
+        const FRowSummary* NewRow = NewRows.IsValidIndex(i) && NewRows[i].Count > 0 ? &NewRows[i] : nullptr;
+        if (!OldRow && !NewRow)
+            continue;
+        if (!OldRow || !NewRow)
+        {
+            const FRowSummary& Row = OldRow ? *OldRow : *NewRow;
+            Lines.Add(FString::Printf(TEXT("Row %d: %s (%d %s %s)"), i + 1, OldRow ? TEXT("removed") : TEXT("added"),
+                                      Row.Count, *GetTypeName(Row.Type), *Row.Recipe));
+            continue;
+        }
+
+        TArray<FString> Changes;
+        if (OldRow->Type != NewRow->Type || OldRow->Count != NewRow->Count)
+            Changes.Add(FString::Printf(TEXT("%d %s -> %d %s"), OldRow->Count, *GetTypeName(OldRow->Type),
+                                        NewRow->Count, *GetTypeName(NewRow->Type)));
+        if (OldRow->Recipe != NewRow->Recipe)
+            Changes.Add(FString::Printf(TEXT("recipe %s -> %s"), *OldRow->Recipe, *NewRow->Recipe));
+        if (!FMath::IsNearlyEqual(OldRow->ClockPercent, NewRow->ClockPercent, 0.001f))
+            Changes.Add(FString::Printf(TEXT("clock %.1f%% -> %.1f%%"), OldRow->ClockPercent, NewRow->ClockPercent));
+        if (!OldRow->Origin.Equals(NewRow->Origin, 1.0f))
+        {
+            const FVector3f Offset = (NewRow->Origin - OldRow->Origin) / 100.0f;
+            Changes.Add(FString::Printf(TEXT("moved by (%.0f, %.0f, %.0f) m"), Offset.X, Offset.Y, Offset.Z));
+        }
+
+        if (Changes.Num() > 0)
+            Lines.Add(FString::Printf(TEXT("Row %d: %s"), i + 1, *FString::Join(Changes, TEXT(", "))));
+    }
+
+    // Same counts and rows, but e.g. ports or poles differ
+    if (Lines.IsEmpty() && GetHash(Old) != GetHash(New))
+        Lines.Add(TEXT("Same buildables and rows, but different positions or connections"));
+    return Lines;
+}
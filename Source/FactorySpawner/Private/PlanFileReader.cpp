@@ -0,0 +1,296 @@
+#include "PlanFileReader.h"
+#include "FactoryCommandParser.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+
+namespace
+{
+    constexpr int64 ChunkSize = 64 * 1024;
+
+    // Feeds parsed groups to the row callback and keeps track of the command-level options
+    struct FGroupSink
+    {
+        FPlanFileReader::FOnRow OnRow;
+        FFactoryCommandOptions Options;
+        int32 GroupIndex = 0;
+        int32 NumRows = 0;
+
+        explicit FGroupSink(FPlanFileReader::FOnRow InOnRow) : OnRow(InOnRow)
+        {
+        }
+
+        bool Add(const FString& Group, FString& OutError)
+        {
+            const FFactoryCommandOptions Before = Options;
+            TOptional<FFactoryCommandToken> Row;
+            if (!FFactoryCommandParser::ParseGroup(Group, GroupIndex++, Options, Row, OutError))
+                return false;
+
+            // The first rows are already laid out at this point; in the chat these options apply to every row
+            if (NumRows > 0)
+            {
+                const TCHAR* Late = !(Options.BeltTier == Before.BeltTier)      ? TEXT("beltTier")
+                                    : Options.PowerScheme != Before.PowerScheme ? TEXT("power")
+                                    : Options.FloorHeight != Before.FloorHeight ? TEXT("floor")
+                                                                                : nullptr;
+                if (Late)
+                {
+                    OutError = FString::Printf(TEXT("%s must come before the first row"), Late);
+                    return false;
+                }
+            }
+
+            if (!Row.IsSet())
+                return true;
+
+            FFactoryCommandParser::ApplyOptions(Options, Row.GetValue());
+            ++NumRows;
+            return OnRow(Row.GetValue(), OutError);
+        }
+    };
+
+    FString NumberToString(double Value)
+    {
+        return Value == FMath::RoundToDouble(Value) ? FString::Printf(TEXT("%lld"), (int64) Value)
+                                                    : FString::SanitizeFloat(Value);
+    }
+
+    // Builds a command group from the fields of a JSON row
+    bool MakeGroupFromJson(const TMap<FString, FString>& Fields, FString& OutGroup, FString& OutError)
+    {
+        const FString* Count = Fields.Find(TEXT("count"));
+        const FString* Machine = Fields.Find(TEXT("machine"));
+        const FString* Recipe = Fields.Find(TEXT("recipe"));
+        const FString* Clock = Fields.Find(TEXT("clock"));
+        const FString* Rate = Fields.Find(TEXT("rate"));
+        const FString* Sloops = Fields.Find(TEXT("sloops"));
+        const FString* Machines = Fields.Find(TEXT("machines"));
+        const FString* Inputs = Fields.Find(TEXT("inputs"));
+
+        if (!Machine || (!Count && !Rate))
+        {
+            OutError = TEXT("JSON row needs \"machine\" and \"count\" or \"rate\"");
+            return false;
+        }
+        if (Clock && !Recipe)
+        {
+            OutError = TEXT("JSON row with \"clock\" needs a \"recipe\"");
+            return false;
+        }
+
+        // Display names ("Iron Ingot") are matched in PascalCase
+        OutGroup = FString::Printf(TEXT("%s %s"), Count ? **Count : TEXT("auto"),
+                                   *Machine->Replace(TEXT(" "), TEXT("")));
+        if (Recipe)
+            OutGroup += TEXT(" ") + Recipe->Replace(TEXT(" "), TEXT(""));
+        if (Clock)
+            OutGroup += TEXT(" ") + *Clock;
+        if (Rate)
+            OutGroup += TEXT(" rate=") + *Rate;
+        if (Sloops)
+            OutGroup += TEXT(" sloops=") + *Sloops;
+        if (Machines)
+            OutGroup += TEXT(" machines=") + *Machines;
+        if (Inputs)
+            OutGroup += TEXT(" inputs=") + *Inputs;
+        return true;
+    }
+} // namespace
+
+FString FPlanFileReader::FindPlanFile(const FString& Name)
+{
+    // Plain file names only, no way out of the plan folders
+    if (Name.IsEmpty() || Name.Contains(TEXT("..")) || !FPaths::IsRelative(Name))
+        return FString();
+
+    const TArray<FString> Folders = {FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FactorySpawner")),
+                                     FPaths::Combine(FPaths::ProjectConfigDir(), TEXT("FactorySpawner"))};
+    const TArray<FString> Extensions = {TEXT(""), TEXT(".txt"), TEXT(".json")};
+
+    for (const FString& Folder : Folders)
+    {
+        for (const FString& Extension : Extensions)
+        {
+            const FString Path = FPaths::Combine(Folder, Name + Extension);
+            if (FPaths::FileExists(Path))
+                return Path;
+        }
+    }
+    return FString();
+}
+
+bool FPlanFileReader::ReadFile(const FString& Path, FOnRow OnRow, FString& OutError)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path));
+    if (!Reader)
+    {
+        OutError = FString::Printf(TEXT("Cannot open '%s'"), *Path);
+        return false;
+    }
+
+    // Sniff the format from the first non-whitespace character
+    bool bJson = Path.EndsWith(TEXT(".json"), ESearchCase::IgnoreCase);
+    uint8 Peek[64];
+    const int64 PeekSize = FMath::Min<int64>(sizeof(Peek), Reader->TotalSize());
+    Reader->Serialize(Peek, PeekSize);
+    for (int64 i = 0; i < PeekSize && !bJson; ++i)
+    {
+        if (Peek[i] == '{' || Peek[i] == '[')
+            bJson = true;
+        else if (!FChar::IsWhitespace(Peek[i]) && Peek[i] < 0x80)
+            break;
+    }
+
+    // Skip the UTF-8 byte order mark
+    const bool bHasBom = PeekSize >= 3 && Peek[0] == 0xEF && Peek[1] == 0xBB && Peek[2] == 0xBF;
+    Reader->Seek(bHasBom ? 3 : 0);
+
+    const bool bOk = bJson ? ReadJsonStream(*Reader, OnRow, OutError) : ReadCommandStream(*Reader, OnRow, OutError);
+    Reader->Close();
+    return bOk;
+}
+
+bool FPlanFileReader::ReadCommandStream(FArchive& Reader, FOnRow OnRow, FString& OutError)
+{
+    FGroupSink Sink(OnRow);
+
+    // Groups are split on raw bytes: ',' and line breaks never occur inside a UTF-8 sequence
+    TArray<uint8> Buffer;
+    Buffer.SetNumUninitialized(ChunkSize);
+    TArray<uint8> Pending;
+    bool bComment = false;
+    bool bBlank = true;
+
+    auto Flush = [&]() -> bool
+    {
+        FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Pending.GetData()), Pending.Num());
+        FString Group(Converted.Length(), Converted.Get());
+        Pending.Reset();
+        bBlank = true;
+
+        // Allow a pasted chat command
+        if (Sink.GroupIndex == 0)
+        {
+            Group.TrimStartInline();
+            Group.RemoveFromStart(TEXT("/FactorySpawner"), ESearchCase::IgnoreCase);
+        }
+        return Sink.Add(Group, OutError);
+    };
+
+    while (!Reader.AtEnd())
+    {
+        const int64 Size = FMath::Min(ChunkSize, Reader.TotalSize() - Reader.Tell());
+        Reader.Serialize(Buffer.GetData(), Size);
+        if (Reader.IsError())
+        {
+            OutError = TEXT("Read error");
+            return false;
+        }
+
+        for (int64 i = 0; i < Size; ++i)
+        {
+            const uint8 Char = Buffer[i];
+            if (Char == '\n' || Char == '\r')
+            {
+                bComment = false;
+                if (!bBlank && !Flush())
+                    return false;
+                continue;
+            }
+            if (bComment)
+                continue;
+            if (Char == '#' && bBlank)
+            {
+                bComment = true;
+                continue;
+            }
+            if (Char == ',')
+            {
+                if (!Flush())
+                    return false;
+                continue;
+            }
+
+            Pending.Add(Char);
+            bBlank = bBlank && FChar::IsWhitespace(Char);
+        }
+    }
+
+    return bBlank || Flush();
+}
+
+bool FPlanFileReader::ReadJsonStream(FArchive& Reader, FOnRow OnRow, FString& OutError)
+{
+    FGroupSink Sink(OnRow);
+    TSharedRef<TJsonReader<UTF8CHAR>> Json = TJsonReaderFactory<UTF8CHAR>::Create(&Reader);
+
+    // Rows are the objects inside the top-level array, or inside "rows" of the top-level object
+    int32 Depth = 0;
+    int32 RowDepth = INDEX_NONE;
+    bool bTopLevelObject = false;
+    bool bInRow = false;
+    TMap<FString, FString> Fields;
+
+    EJsonNotation Notation;
+    while (Json->ReadNext(Notation))
+    {
+        const FString Identifier = Json->GetIdentifier().ToLower();
+        FString Value;
+
+        switch (Notation)
+        {
+        case EJsonNotation::ArrayStart:
+            ++Depth;
+            if ((Depth == 1) || (Depth == 2 && bTopLevelObject && Identifier == TEXT("rows")))
+                RowDepth = Depth + 1;
+            continue;
+        case EJsonNotation::ObjectStart:
+            ++Depth;
+            bTopLevelObject |= Depth == 1;
+            if (Depth == RowDepth)
+            {
+                bInRow = true;
+                Fields.Reset();
+            }
+            continue;
+        case EJsonNotation::ObjectEnd:
+            if (bInRow && Depth == RowDepth)
+            {
+                bInRow = false;
+                FString Group;
+                if (!MakeGroupFromJson(Fields, Group, OutError) || !Sink.Add(Group, OutError))
+                    return false;
+            }
+            --Depth;
+            continue;
+        case EJsonNotation::ArrayEnd:
+            --Depth;
+            continue;
+        case EJsonNotation::String:
+            Value = Json->GetValueAsString();
+            break;
+        case EJsonNotation::Number:
+            Value = NumberToString(Json->GetValueAsNumber());
+            break;
+        default:
+            continue;
+        }
+
+        if (bInRow && Depth == RowDepth)
+            Fields.Add(Identifier, Value);
+        else if (bTopLevelObject && Depth == 1 &&
+                 (Identifier == TEXT("belttier") || Identifier == TEXT("power") || Identifier == TEXT("floor")))
+        {
+            if (!Sink.Add(FString::Printf(TEXT("%s %s"), *Identifier, *Value), OutError))
+                return false;
+        }
+    }
+
+    if (Notation == EJsonNotation::Error)
+    {
+        OutError = FString::Printf(TEXT("Invalid JSON: %s"), *Json->GetErrorMessage());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,187 @@
+#include "PlanStatistics.h"
+#include "BuildableCache.h"
+#include "ClockPlanner.h"
+#include "GeneratorFuel.h"
+#include "FGRecipe.h"
+#include "Resources/FGItemDescriptor.h"
+
+namespace
+{
+    // The build gun charges splines per started segment: belts, lifts and pipes per 2 m, power lines per 25 m
+    constexpr float TransportCostSegment = 200.0f;
+    constexpr float PowerLineCostSegment = 2500.0f;
+
+    void AddSpline(FSplineTotals& Totals, float Length, float CostSegment)
+    {
+        ++Totals.Count;
+        Totals.Length += Length / 100.0f;
+        Totals.CostUnits += FMath::Max(1, FMath::CeilToInt(Length / CostSegment));
+    }
+
+    FString GetTypeName(EBuildable Type)
+    {
+        return StaticEnum<EBuildable>()->GetNameStringByValue((int64) Type);
+    }
+
+    // "Build_Pulverizer_C" for a custom machine's class path
+    FString GetClassName(const FString& ClassPath)
+    {
+        return FSoftObjectPath(ClassPath).GetAssetName();
+    }
+
+    // "3 Mk2 (40 m)" for every tier in use
+    FString FormatTiers(const FSplineTotals* Tiers, int32 NumTiers, const TCHAR* Unit)
+    {
+        TArray<FString> Parts;
+        for (int32 i = 0; i < NumTiers; ++i)
+        {
+            if (Tiers[i].Count > 0)
+                Parts.Add(FString::Printf(TEXT("%d Mk%d (%.0f %s)"), Tiers[i].Count, i + 1, Tiers[i].Length, Unit));
+        }
+        return Parts.IsEmpty() ? TEXT("none") : FString::Join(Parts, TEXT(", "));
+    }
+} // namespace
+
+FPlanStatistics FPlanStatistics::Compute(const FBuildPlanView& Plan, UBuildableCache* Cache)
+{
+    FPlanStatistics Stats;
+
+    for (const FPlannedBuildable& Buildable : Plan.Buildables)
+    {
+        ++Stats.Buildables.FindOrAdd(Buildable.Type);
+        const FString& MachineClass = Plan.GetMachineClassPath(Buildable);
+        if (!MachineClass.IsEmpty())
+            ++Stats.CustomMachines.FindOrAdd(MachineClass);
+
+        const FVector Location(Buildable.Location);
+        const FIntPoint Size = Cache->GetMachineSize(Buildable.Type, MachineClass);
+        const FVector Extent(Size.X * 50.0f, Size.Y * 50.0f, 0.0f);
+        Stats.Bounds += FBox(Location - Extent, Location + Extent);
+
+        if (IsGenerator(Buildable.Type))
+            Stats.PowerOutput +=
+                FGeneratorFuels::Estimate(Buildable.Type, nullptr, 1, Buildable.ClockPercent).PowerOutput;
+        else if (Buildable.Type < EBuildable::Splitter)
+            Stats.PowerDraw +=
+                FClockPlanner::GetMachinePower(Buildable.Type, Buildable.ClockPercent, Buildable.ProductionBoost);
+    }
+
+    for (const FPlannedConnection& Connection : Plan.Connections)
+    {
+        const FVector From(Plan.Buildables[Connection.From].Location);
+        const FVector To(Plan.Buildables[Connection.To].Location);
+        const int32 Tier = FMath::Max<int32>(Connection.Tier, 1);
+
+        switch (Connection.Type)
+        {
+        case EPlannedLink::Belt:
+            if (ShouldUseLift(From, To))
+                AddSpline(Stats.Lifts[FMath::Min(Tier, 6) - 1], FMath::Abs(From.Z - To.Z), TransportCostSegment);
+            else
+                AddSpline(Stats.Belts[FMath::Min(Tier, 6) - 1], FVector::Distance(From, To), TransportCostSegment);
+            break;
+        case EPlannedLink::Pipe:
+            AddSpline(Stats.Pipes[FMath::Min(Tier, 2) - 1], FVector::Distance(From, To), TransportCostSegment);
+            break;
+        case EPlannedLink::PowerLine:
+            AddSpline(Stats.PowerLines, FVector::Distance(From, To), PowerLineCostSegment);
+            break;
+        }
+    }
+
+    return Stats;
+}
+
+void FPlanStatistics::ComputeBuildCost(UBuildableCache* Cache, UWorld* World)
+{
+    BuildCost.Reset();
+    MissingBuildRecipes.Reset();
+
+    auto AddCost = [&](TSubclassOf<AFGBuildable> Class, int32 Units, const FString& Name)
+    {
+        if (Units <= 0)
+            return;
+        TSubclassOf<UFGRecipe> Recipe = Class ? Cache->GetBuildRecipe(Class, World) : nullptr;
+        if (!Recipe)
+        {
+            MissingBuildRecipes.AddUnique(Name);
+            return;
+        }
+        for (const FItemAmount& Ingredient : UFGRecipe::GetIngredients(Recipe))
+            BuildCost.FindOrAdd(Ingredient.ItemClass) += Ingredient.Amount * Units;
+    };
+
+    for (const TPair<EBuildable, int32>& Pair : Buildables)
+    {
+        if (Pair.Key != EBuildable::CustomMachine)
+            AddCost(Cache->GetBuildableClass<AFGBuildable>(Pair.Key), Pair.Value, GetTypeName(Pair.Key));
+    }
+    for (const TPair<FString, int32>& Pair : CustomMachines)
+        AddCost(Cache->GetMachineClass(EBuildable::CustomMachine, Pair.Key), Pair.Value, GetClassName(Pair.Key));
+    for (int32 i = 0; i < 6; ++i)
+    {
+        AddCost(Cache->GetTieredClass(EBuildable::Belt, i + 1), Belts[i].CostUnits,
+                FString::Printf(TEXT("Belt Mk%d"), i + 1));
+        AddCost(Cache->GetTieredClass(EBuildable::Lift, i + 1), Lifts[i].CostUnits,
+                FString::Printf(TEXT("Lift Mk%d"), i + 1));
+    }
+    for (int32 i = 0; i < 2; ++i)
+        AddCost(Cache->GetTieredClass(EBuildable::Pipeline, i + 1), Pipes[i].CostUnits,
+                FString::Printf(TEXT("Pipeline Mk%d"), i + 1));
+    AddCost(Cache->GetBuildableClass<AFGBuildable>(EBuildable::PowerLine), PowerLines.CostUnits,
+            GetTypeName(EBuildable::PowerLine));
+}
+
+TArray<FString> FPlanStatistics::GetReport() const
+{
+    TArray<FString> Lines;
+
+    TArray<FString> Machines, Others;
+    TArray<EBuildable> Types;
+    Buildables.GetKeys(Types);
+    Types.Sort();
+    for (EBuildable Type : Types)
+    {
+        // Listed by class below
+        if (Type == EBuildable::CustomMachine)
+            continue;
+        const FString Entry = FString::Printf(TEXT("%d %s"), Buildables[Type], *GetTypeName(Type));
+        (Type < EBuildable::Splitter ? Machines : Others).Add(Entry);
+    }
+    for (const TPair<FString, int32>& Pair : CustomMachines)
+        Machines.Add(FString::Printf(TEXT("%d %s"), Pair.Value, *GetClassName(Pair.Key)));
+    Lines.Add(TEXT("Machines: ") + FString::Join(Machines, TEXT(", ")));
+    if (Others.Num() > 0)
+        Lines.Add(TEXT("Parts: ") + FString::Join(Others, TEXT(", ")));
+
+    Lines.Add(FString::Printf(TEXT("Belts: %s. Lifts: %s"), *FormatTiers(Belts, 6, TEXT("m")),
+                              *FormatTiers(Lifts, 6, TEXT("m high"))));
+    Lines.Add(FString::Printf(TEXT("Pipes: %s. Power lines: %d (%.0f m)"), *FormatTiers(Pipes, 2, TEXT("m")),
+                              PowerLines.Count, PowerLines.Length));
+
+    if (Bounds.IsValid)
+    {
+        const FVector Size = Bounds.GetSize() / 100.0f;
+        Lines.Add(FString::Printf(TEXT("Area: %.0f x %.0f m, %.0f m high"), Size.X, Size.Y, Size.Z));
+    }
+
+    FString Power = FString::Printf(TEXT("Power draw: %.1f MW"), PowerDraw);
+    if (PowerOutput > 0.0f)
+        Power += FString::Printf(TEXT(", generators: %.0f MW"), PowerOutput);
+    Lines.Add(Power);
+
+    if (BuildCost.Num() > 0)
+    {
+        TArray<TPair<TSubclassOf<UFGItemDescriptor>, int32>> Items = BuildCost.Array();
+        Items.Sort([](const auto& A, const auto& B) { return A.Value > B.Value; });
+
+        TArray<FString> Parts;
+        for (const auto& Item : Items)
+            Parts.Add(FString::Printf(TEXT("%d %s"), Item.Value, *UFGItemDescriptor::GetItemName(Item.Key).ToString()));
+        Lines.Add(TEXT("Cost: ") + FString::Join(Parts, TEXT(", ")));
+    }
+    if (MissingBuildRecipes.Num() > 0)
+        Lines.Add(TEXT("Not unlocked (no cost): ") + FString::Join(MissingBuildRecipes, TEXT(", ")));
+
+    return Lines;
+}
@@ -0,0 +1,247 @@
+#include "PowerPlanner.h"
+#include "FactorySpawner.h"
+#include "Misc/MemStack.h"
+
+namespace
+{
+    // Power lines reach 100 m; keep a margin because anchors are not exactly at the machine's power port
+    constexpr float MaxWireLength = 9000.0f;
+
+    // Connections kept free on the first pole, so the player can hook the factory up to the grid
+    constexpr int32 GridConnectionSlots = 1;
+
+    void WarnIfTooLong(const FPowerNetworkPlan& Plan, int32 From, int32 To)
+    {
+        if (FVector::DistSquared(Plan.Poles[From].Location, Plan.Poles[To].Location) > FMath::Square(MaxWireLength))
+            UE_LOG(LogFactorySpawner, Warning, TEXT("Power network: link to pole %d is longer than a power line"),
+                   To);
+    }
+} // namespace
+
+int32 FPowerPlanner::GetPoleConnections(int32 Tier)
+{
+    switch (Tier)
+    {
+    case 3:
+        return 10;
+    case 2:
+        return 7;
+    default:
+        return 4;
+    }
+}
+
+FPowerNetworkPlan FPowerPlanner::Plan(TConstArrayView<FPowerSite> Sites, int32 MaxTier)
+{
+    FPowerNetworkPlan Plan;
+    if (Sites.IsEmpty())
+        return Plan;
+
+    FMemMark Mark(FMemStack::Get());
+    Plan.Poles.Reserve(Sites.Num());
+    Plan.PoleLinks.Reserve(Sites.Num());
+
+    TArray<int32, TMemStackAllocator<>> GroupStarts;
+    PlacePoles(Sites, MaxTier, Plan, GroupStarts);
+    ConnectPoles(GetPoleConnections(MaxTier), GroupStarts, Plan);
+
+    // Pick the cheapest tier that still has enough slots for every wire on the pole
+    TArray<int32, TMemStackAllocator<>> Degree;
+    Degree.SetNumZeroed(Plan.Poles.Num());
+    for (const TPair<int32, int32>& Link : Plan.PoleLinks)
+    {
+        ++Degree[Link.Key];
+        ++Degree[Link.Value];
+    }
+
+    for (int32 i = 0; i < Plan.Poles.Num(); ++i)
+    {
+        FPlannedPole& Pole = Plan.Poles[i];
+        const int32 Needed = Pole.Sites.Num() + Degree[i] + (i == 0 ? GridConnectionSlots : 0);
+        Pole.Tier = Pole.bWallMount ? 1 : MaxTier;
+        for (int32 Tier = 1; Tier < Pole.Tier; ++Tier)
+        {
+            if (GetPoleConnections(Tier) >= Needed)
+            {
+                Pole.Tier = Tier;
+                break;
+            }
+        }
+    }
+
+    return Plan;
+}
+
+void FPowerPlanner::PlacePoles(TConstArrayView<FPowerSite> Sites, int32 MaxTier, FPowerNetworkPlan& Plan,
+                               TArray<int32, TMemStackAllocator<>>& OutGroupStarts)
+{
+    // Order the sites by group (in order of first appearance), then along the row
+    TMap<int32, int32, TInlineSetAllocator<16>> GroupRanks;
+    TArray<int32, TMemStackAllocator<>> Rank;
+    TArray<int32, TMemStackAllocator<>> Order;
+    Rank.SetNumUninitialized(Sites.Num());
+    Order.SetNumUninitialized(Sites.Num());
+    for (int32 i = 0; i < Sites.Num(); ++i)
+    {
+        Rank[i] = GroupRanks.FindOrAdd(Sites[i].Group, GroupRanks.Num());
+        Order[i] = i;
+    }
+    Order.Sort(
+        [&](int32 A, int32 B)
+        {
+            if (Rank[A] != Rank[B])
+                return Rank[A] < Rank[B];
+            const FVector& LocA = Sites[A].Anchor;
+            const FVector& LocB = Sites[B].Anchor;
+            return LocA.X != LocB.X ? LocA.X < LocB.X : LocA.Y < LocB.Y;
+        });
+
+    int32 GroupStart = 0;
+    while (GroupStart < Order.Num())
+    {
+        int32 GroupEnd = GroupStart + 1;
+        while (GroupEnd < Order.Num() && Rank[Order[GroupEnd]] == Rank[Order[GroupStart]])
+            ++GroupEnd;
+        const TArrayView<const int32> Members(Order.GetData() + GroupStart, GroupEnd - GroupStart);
+        GroupStart = GroupEnd;
+
+        const bool bWallMount = Sites[Members[0]].bWallMount;
+        const int32 Connections = GetPoleConnections(bWallMount ? 1 : MaxTier);
+
+        // The head pole links towards the network (the grid on the root) and keeps a slot for the head of another
+        // group; every other pole links to the previous one. All but the last pole link to the next one.
+        const bool bFirstGroup = OutGroupStarts.IsEmpty();
+        const int32 HeadLinks = (bFirstGroup ? GridConnectionSlots : 1) + (GroupRanks.Num() > 1 ? 1 : 0);
+        OutGroupStarts.Add(Plan.Poles.Num());
+
+        // Greedily grow each pole's share of the row while the middle anchor can still reach both ends
+        int32 Start = 0;
+        while (Start < Members.Num())
+        {
+            const int32 InLinks = Start == 0 ? HeadLinks : 1;
+            auto GetMaxSites = [&](bool bLast) { return FMath::Max(1, Connections - InLinks - (bLast ? 0 : 1)); };
+
+            int32 End = Start;
+            while (End + 1 < Members.Num() && End + 1 - Start + 1 <= GetMaxSites(End + 2 == Members.Num()))
+            {
+                const FVector& Candidate = Sites[Members[Start + (End + 2 - Start) / 2]].Anchor;
+                if (FVector::Dist(Candidate, Sites[Members[Start]].Anchor) > MaxWireLength ||
+                    FVector::Dist(Candidate, Sites[Members[End + 1]].Anchor) > MaxWireLength)
+                    break;
+                ++End;
+            }
+
+            FPlannedPole& Pole = Plan.Poles.AddDefaulted_GetRef();
+            Pole.Location = Sites[Members[Start + (End + 1 - Start) / 2]].Anchor;
+            Pole.bWallMount = bWallMount;
+            for (int32 i = Start; i <= End; ++i)
+                Pole.Sites.Add(Members[i]);
+
+            Start = End + 1;
+        }
+    }
+}
+
+void FPowerPlanner::ConnectPoles(int32 MaxConnections, TConstArrayView<int32> GroupStarts, FPowerNetworkPlan& Plan)
+{
+    const int32 NumPoles = Plan.Poles.Num();
+    if (NumPoles < 2)
+        return;
+
+    TArray<int32, TMemStackAllocator<>> FreeSlots;
+    FreeSlots.SetNumUninitialized(NumPoles);
+    for (int32 i = 0; i < NumPoles; ++i)
+        FreeSlots[i] = (Plan.Poles[i].bWallMount ? GetPoleConnections(1) : MaxConnections) -
+                       Plan.Poles[i].Sites.Num() - (i == 0 ? GridConnectionSlots : 0);
+
+    auto AddLink = [&](int32 From, int32 To)
+    {
+        WarnIfTooLong(Plan, From, To);
+        Plan.PoleLinks.Emplace(From, To);
+        --FreeSlots[From];
+        --FreeSlots[To];
+    };
+
+    // The poles of a group form a chain along the row
+    const int32 NumGroups = GroupStarts.Num();
+    auto GetGroupEnd = [&](int32 Group) { return Group + 1 < NumGroups ? GroupStarts[Group + 1] : NumPoles; };
+    for (int32 Group = 0; Group < NumGroups; ++Group)
+    {
+        for (int32 i = GroupStarts[Group] + 1; i < GetGroupEnd(Group); ++i)
+            AddLink(i - 1, i);
+    }
+
+    TArray<bool, TMemStackAllocator<>> InTree;
+    InTree.SetNumZeroed(NumGroups);
+    InTree[0] = true;
+
+    TArray<int32, TMemStackAllocator<>> Tree;
+    Tree.Reserve(NumPoles);
+    for (int32 i = 0; i < GetGroupEnd(0); ++i)
+        Tree.Add(i);
+
+    // Cheapest known attachment for the head pole of every group outside the tree
+    TArray<int32, TMemStackAllocator<>> BestFrom;
+    TArray<float, TMemStackAllocator<>> BestDist;
+    BestFrom.Init(INDEX_NONE, NumGroups);
+    BestDist.Init(MAX_flt, NumGroups);
+
+    // Prim's algorithm over the groups; a pole that ran out of slots can no longer accept links
+    for (int32 Joined = 1; Joined < NumGroups; ++Joined)
+    {
+        int32 Next = INDEX_NONE;
+        for (int32 Group = 0; Group < NumGroups; ++Group)
+        {
+            if (InTree[Group])
+                continue;
+
+            const int32 Head = GroupStarts[Group];
+            if (BestFrom[Group] == INDEX_NONE || FreeSlots[BestFrom[Group]] <= 0)
+            {
+                BestFrom[Group] = INDEX_NONE;
+                BestDist[Group] = MAX_flt;
+                for (int32 Member : Tree)
+                {
+                    const float Dist = FVector::DistSquared(Plan.Poles[Member].Location, Plan.Poles[Head].Location);
+                    if (FreeSlots[Member] > 0 && Dist < BestDist[Group])
+                    {
+                        BestFrom[Group] = Member;
+                        BestDist[Group] = Dist;
+                    }
+                }
+            }
+
+            if (BestFrom[Group] != INDEX_NONE && (Next == INDEX_NONE || BestDist[Group] < BestDist[Next]))
+                Next = Group;
+        }
+
+        if (Next == INDEX_NONE)
+        {
+            UE_LOG(LogFactorySpawner, Warning, TEXT("Power network: %d rows could not be linked (no free slots)"),
+                   NumGroups - Joined);
+            return;
+        }
+
+        AddLink(BestFrom[Next], GroupStarts[Next]);
+        InTree[Next] = true;
+
+        for (int32 Member = GroupStarts[Next]; Member < GetGroupEnd(Next); ++Member)
+        {
+            Tree.Add(Member);
+            if (FreeSlots[Member] <= 0)
+                continue;
+            for (int32 Group = 0; Group < NumGroups; ++Group)
+            {
+                if (InTree[Group])
+                    continue;
+                const float Dist =
+                    FVector::DistSquared(Plan.Poles[Member].Location, Plan.Poles[GroupStarts[Group]].Location);
+                if (Dist < BestDist[Group])
+                {
+                    BestFrom[Group] = Member;
+                    BestDist[Group] = Dist;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#include "RecipeIndex.h"
+#include "FactorySpawner.h"
+#include "Dom/JsonObject.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+FString FRecipeIndex::GetPath()
+{
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FactorySpawner"), TEXT("RecipeIndex.json"));
+}
+
+FString FRecipeIndex::GetEnvironmentKey()
+{
+    // Plugins cannot change while the game runs
+    static const FString Key = []
+    {
+        TArray<FString> Plugins;
+        for (const TSharedRef<IPlugin>& Plugin : IPluginManager::Get().GetEnabledPlugins())
+            Plugins.Add(Plugin->GetName() + TEXT("@") + Plugin->GetDescriptor().VersionName);
+        Plugins.Sort();
+
+        return FString::Printf(TEXT("%s/%08x"), *FEngineVersion::Current().ToString(),
+                               FCrc::StrCrc32(*FString::Join(Plugins, TEXT(","))));
+    }();
+    return Key;
+}
+
+TMap<FString, FString> FRecipeIndex::Load()
+{
+    TMap<FString, FString> Recipes;
+
+    FString Text;
+    if (!FFileHelper::LoadFileToString(Text, *GetPath()))
+        return Recipes;
+
+    TSharedPtr<FJsonObject> Root;
+    if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Text), Root) || !Root.IsValid())
+    {
+        UE_LOG(LogFactorySpawner, Warning, TEXT("Ignoring unreadable %s"), *GetPath());
+        return Recipes;
+    }
+
+    // Another build or mod set may name or produce recipes differently
+    if (Root->GetIntegerField(TEXT("version")) != Version ||
+        Root->GetStringField(TEXT("environment")) != GetEnvironmentKey())
+        return Recipes;
+
+    const TSharedPtr<FJsonObject>* Entries;
+    if (Root->TryGetObjectField(TEXT("recipes"), Entries))
+    {
+        for (const TPair<FString, TSharedPtr<FJsonValue>>& Entry : (*Entries)->Values)
+            Recipes.Add(Entry.Key, Entry.Value->AsString());
+    }
+
+    UE_LOG(LogFactorySpawner, Log, TEXT("Loaded %d indexed recipe names"), Recipes.Num());
+    return Recipes;
+}
+
+void FRecipeIndex::Save(const TMap<FString, FString>& Recipes)
+{
+    const TSharedRef<FJsonObject> Entries = MakeShared<FJsonObject>();
+    for (const TPair<FString, FString>& Recipe : Recipes)
+        Entries->SetStringField(Recipe.Key, Recipe.Value);
+
+    const TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+    Root->SetNumberField(TEXT("version"), Version);
+    Root->SetStringField(TEXT("environment"), GetEnvironmentKey());
+    Root->SetObjectField(TEXT("recipes"), Entries);
+
+    FString Text;
+    if (!FJsonSerializer::Serialize(Root, TJsonWriterFactory<>::Create(&Text)) ||
+        !FFileHelper::SaveStringToFile(Text, *GetPath(), FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+        UE_LOG(LogFactorySpawner, Warning, TEXT("Could not write %s"), *GetPath());
+}
@@ -0,0 +1,297 @@
+#include "RowSimulator.h"
+
+namespace
+{
+    // Utilization is measured and steady state detected per simulated minute
+    constexpr float WindowSeconds = 60.0f;
+    constexpr float RunningUtilization = 0.99f;
+
+    // A full belt holds about one item per meter
+    constexpr float ItemsPerMeter = 1.0f;
+
+    // Chain of splitters (or mergers) along the row; segment i ends at (or starts from) machine i
+    struct FSimulatedManifold
+    {
+        TArray<float> Segments;
+        float SegmentCapacity = 0.0f;
+        float StepRate = 0.0f; // Items a splitter or merger passes per time step
+    };
+
+    // Shares Available between two receivers evenly, the share one cannot take goes to the other
+    void ShareEvenly(float Available, float RoomA, float RoomB, float& OutA, float& OutB)
+    {
+        OutA = FMath::Min(RoomA, Available * 0.5f);
+        OutB = FMath::Min(RoomB, Available * 0.5f);
+        const float Left = Available - OutA - OutB;
+        const float ExtraA = FMath::Min(RoomA - OutA, Left);
+        OutA += ExtraA;
+        OutB += FMath::Min(RoomB - OutB, Left - ExtraA);
+    }
+
+    FSimulatedManifold MakeManifold(const FRowSimulationInput& Input, const FSimulatedItem& Item)
+    {
+        FSimulatedManifold Manifold;
+        Manifold.Segments.SetNumZeroed(Input.Machines);
+        // Items on a mixed belt are modelled as lanes of their own, each with its share of the belt
+        Manifold.StepRate =
+            (Item.bFluid ? Input.PipeRate : Input.BeltRate) * Item.BeltShare / 60.0f * FRowSimulator::TimeStep;
+        Manifold.SegmentCapacity =
+            FMath::Max(Input.MachineSpacing * ItemsPerMeter * Item.BeltShare, Manifold.StepRate * 2.0f);
+        return Manifold;
+    }
+
+    enum class EMachineState : uint8
+    {
+        Working,
+        Starved,
+        Blocked
+    };
+} // namespace
+
+FRowSimulationResult FRowSimulator::Simulate(const FRowSimulationInput& Input)
+{
+    const double StartTime = FPlatformTime::Seconds();
+    FRowSimulationResult Result;
+
+    const int32 N = Input.Machines;
+    if (N <= 0 || Input.CycleSeconds.Num() != N || Input.ProductionBoost.Num() != N ||
+        FMath::Min(Input.CycleSeconds) <= 0.0f)
+        return Result;
+
+    const int32 NumIn = Input.Ingredients.Num();
+    const int32 NumOut = Input.Products.Num();
+    auto GetBoost = [&](int32 Machine) { return Input.ProductionBoost[Machine]; };
+
+    if (NumOut > 0)
+    {
+        for (int32 i = 0; i < N; ++i)
+            Result.PlannedOutput += Input.Products[0].PerCycle * GetBoost(i) * 60.0f / Input.CycleSeconds[i];
+    }
+
+    // Manifolds and machine slots, flat per item: [Item * N + Machine]
+    TArray<FSimulatedManifold> InManifolds, OutManifolds;
+    TArray<float> FeedPerStep;
+    float CyclesPerMinute = 0.0f;
+    for (float Cycle : Input.CycleSeconds)
+        CyclesPerMinute += 60.0f / Cycle;
+    for (int32 j = 0; j < NumIn; ++j)
+    {
+        const FSimulatedItem& Item = Input.Ingredients[j];
+        InManifolds.Add(MakeManifold(Input, Item));
+
+        const float Demand = Item.PerCycle * CyclesPerMinute;
+        const float Capacity = (Item.bFluid ? Input.PipeRate : Input.BeltRate) * Item.BeltShare;
+        const float Feed = Input.FeedRates.IsValidIndex(j) ? Input.FeedRates[j] : FMath::Min(Demand, Capacity);
+        FeedPerStep.Add(Feed / 60.0f * TimeStep);
+    }
+    for (const FSimulatedItem& Item : Input.Products)
+        OutManifolds.Add(MakeManifold(Input, Item));
+
+    TArray<float> InSlots, OutSlots;
+    InSlots.SetNumZeroed(NumIn * N);
+    OutSlots.SetNumZeroed(NumOut * N);
+
+    TArray<float> Remaining;          // Seconds left of the running cycle, 0 when idle
+    TArray<uint8> PendingOutput;      // Cycle done, products do not fit yet
+    TArray<float> WorkTime, StarvedTime, BlockedTime, LastIdle;
+    Remaining.SetNumZeroed(N);
+    PendingOutput.SetNumZeroed(N);
+    WorkTime.SetNumZeroed(N);
+    StarvedTime.SetNumZeroed(N);
+    BlockedTime.SetNumZeroed(N);
+    LastIdle.SetNumZeroed(N);
+
+    float WindowOutput = 0.0f, LastWindowOutput = -1.0f, LastStored = -1.0f;
+    float Time = 0.0f, WindowStart = 0.0f;
+
+    auto OutputsFit = [&](int32 i)
+    {
+        for (int32 k = 0; k < NumOut; ++k)
+        {
+            if (OutSlots[k * N + i] + Input.Products[k].PerCycle * GetBoost(i) > Input.Products[k].StackSize)
+                return false;
+        }
+        return true;
+    };
+
+    while (Time < MaxSimulatedSeconds)
+    {
+        // Ingredients: feed the head, then splitters from the end of the row, so freed room is used next step
+        for (int32 j = 0; j < NumIn; ++j)
+        {
+            FSimulatedManifold& Manifold = InManifolds[j];
+            Manifold.Segments[0] += FMath::Min(FeedPerStep[j], Manifold.SegmentCapacity - Manifold.Segments[0]);
+
+            for (int32 i = N - 1; i >= 0; --i)
+            {
+                float& Slot = InSlots[j * N + i];
+                const float Available = FMath::Min(Manifold.Segments[i], Manifold.StepRate);
+                const float RoomMachine = FMath::Max(0.0f, Input.Ingredients[j].StackSize - Slot);
+                const float RoomNext = i + 1 < N ? Manifold.SegmentCapacity - Manifold.Segments[i + 1] : 0.0f;
+
+                float ToMachine, ToNext;
+                ShareEvenly(Available, RoomMachine, RoomNext, ToMachine, ToNext);
+                Manifold.Segments[i] -= ToMachine + ToNext;
+                Slot += ToMachine;
+                if (ToNext > 0.0f)
+                    Manifold.Segments[i + 1] += ToNext;
+            }
+        }
+
+        // Machines: finish cycles, then start the next one if everything is there
+        for (int32 i = 0; i < N; ++i)
+        {
+            float Worked = 0.0f;
+            if (Remaining[i] > 0.0f)
+            {
+                Worked = FMath::Min(Remaining[i], TimeStep);
+                Remaining[i] -= TimeStep;
+                if (Remaining[i] <= 0.0f)
+                    PendingOutput[i] = 1;
+            }
+
+            if (PendingOutput[i] && OutputsFit(i))
+            {
+                for (int32 k = 0; k < NumOut; ++k)
+                    OutSlots[k * N + i] += Input.Products[k].PerCycle * GetBoost(i);
+                PendingOutput[i] = 0;
+            }
+
+            EMachineState State = EMachineState::Working;
+            if (PendingOutput[i])
+                State = EMachineState::Blocked;
+            else if (Remaining[i] <= 0.0f)
+            {
+                bool bHasIngredients = true;
+                for (int32 j = 0; j < NumIn && bHasIngredients; ++j)
+                    bHasIngredients = InSlots[j * N + i] >= Input.Ingredients[j].PerCycle;
+
+                if (!bHasIngredients)
+                    State = EMachineState::Starved;
+                else if (!OutputsFit(i))
+                    State = EMachineState::Blocked;
+                else
+                {
+                    for (int32 j = 0; j < NumIn; ++j)
+                        InSlots[j * N + i] -= Input.Ingredients[j].PerCycle;
+                    // Time left over from the last cycle counts towards the new one
+                    const float Carry = FMath::Min(-Remaining[i], TimeStep - Worked);
+                    Remaining[i] = Input.CycleSeconds[i] - Carry;
+                    Worked += Carry;
+                }
+            }
+            if (State != EMachineState::Working)
+                Remaining[i] = 0.0f;
+
+            WorkTime[i] += Worked;
+            if (State == EMachineState::Starved)
+                StarvedTime[i] += TimeStep - Worked;
+            else if (State == EMachineState::Blocked)
+                BlockedTime[i] += TimeStep - Worked;
+            if (Worked < TimeStep * RunningUtilization)
+                LastIdle[i] = Time + TimeStep;
+        }
+
+        // Products: drain the head, then mergers from the head on, each taking from its machine and the belt behind
+        for (int32 k = 0; k < NumOut; ++k)
+        {
+            FSimulatedManifold& Manifold = OutManifolds[k];
+            const float Drained = FMath::Min(Manifold.Segments[0], Manifold.StepRate);
+            Manifold.Segments[0] -= Drained;
+            if (k == 0)
+                WindowOutput += Drained;
+
+            for (int32 i = 0; i < N; ++i)
+            {
+                float& Slot = OutSlots[k * N + i];
+                const float Room = FMath::Min(Manifold.SegmentCapacity - Manifold.Segments[i], Manifold.StepRate);
+                const float Behind = i + 1 < N ? Manifold.Segments[i + 1] : 0.0f;
+
+                // Fair share of the merger between the machine and the belt behind it
+                float FromMachine, FromBehind;
+                ShareEvenly(Room, Slot, Behind, FromMachine, FromBehind);
+                Slot -= FromMachine;
+                if (FromBehind > 0.0f)
+                    Manifold.Segments[i + 1] -= FromBehind;
+                Manifold.Segments[i] += FromMachine + FromBehind;
+            }
+        }
+
+        Time += TimeStep;
+        if (Time - WindowStart < WindowSeconds - KINDA_SMALL_NUMBER)
+            continue;
+
+        // End of a window: all machines running, or nothing changes any more
+        const float WindowLength = Time - WindowStart;
+        float WindowFeed = 0.0f;
+        for (float Feed : FeedPerStep)
+            WindowFeed += Feed * WindowLength / TimeStep;
+        bool bAllRunning = true;
+        float Stored = 0.0f;
+        for (int32 i = 0; i < N; ++i)
+            bAllRunning &= WorkTime[i] >= WindowLength * RunningUtilization;
+        for (const FSimulatedManifold& Manifold : InManifolds)
+            for (float Segment : Manifold.Segments)
+                Stored += Segment;
+        for (float Slot : InSlots)
+            Stored += Slot;
+
+        Result.SteadyOutput = WindowOutput * 60.0f / WindowLength;
+        const bool bStable = LastWindowOutput >= 0.0f &&
+                             FMath::Abs(WindowOutput - LastWindowOutput) <= 0.005f * FMath::Max(WindowOutput, 1.0f) &&
+                             FMath::Abs(Stored - LastStored) <= 0.005f * FMath::Max(WindowFeed, 1.0f);
+
+        Result.Utilization.SetNum(N);
+        Result.StarvedMachines = Result.BlockedMachines = 0;
+        Result.FirstStarvedMachine = INDEX_NONE;
+        for (int32 i = 0; i < N; ++i)
+        {
+            Result.Utilization[i] = WorkTime[i] / WindowLength;
+            if (Result.Utilization[i] >= RunningUtilization)
+                continue;
+            if (StarvedTime[i] >= BlockedTime[i])
+            {
+                ++Result.StarvedMachines;
+                if (Result.FirstStarvedMachine == INDEX_NONE)
+                    Result.FirstStarvedMachine = i;
+            }
+            else
+                ++Result.BlockedMachines;
+        }
+
+        if (bAllRunning)
+        {
+            Result.SecondsToSteadyState = FMath::Max(LastIdle);
+            break;
+        }
+        if (bStable)
+            break;
+
+        LastWindowOutput = WindowOutput;
+        LastStored = Stored;
+        WindowOutput = 0.0f;
+        WindowStart = Time;
+        for (int32 i = 0; i < N; ++i)
+            WorkTime[i] = StarvedTime[i] = BlockedTime[i] = 0.0f;
+    }
+
+    Result.SimulatedSeconds = Time;
+    Result.CpuMilliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+    return Result;
+}
+
+FString FRowSimulator::GetSummary(const FRowSimulationResult& Result)
+{
+    FString Summary = FString::Printf(TEXT("%.1f of %.1f/min"), Result.SteadyOutput, Result.PlannedOutput);
+
+    const int32 Seconds = FMath::RoundToInt(Result.SecondsToSteadyState);
+    if (Result.SecondsToSteadyState >= 0.0f)
+        Summary += FString::Printf(TEXT(", all machines running after %d:%02d"), Seconds / 60, Seconds % 60);
+
+    if (Result.StarvedMachines > 0)
+        Summary += FString::Printf(TEXT(", %d machines starve (first: #%d)"), Result.StarvedMachines,
+                                   Result.FirstStarvedMachine + 1);
+    if (Result.BlockedMachines > 0)
+        Summary += FString::Printf(TEXT(", %d machines blocked by the output belt"), Result.BlockedMachines);
+    return Summary;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlanTypes.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// One buildable of a plan. Plain data with a fixed layout, so that saved plans can be used straight from the file.
+struct FPlannedBuildable
+{
+    FVector3f Location = FVector3f::ZeroVector; // Relative to the plan origin
+    float ClockPercent = 100.0f;
+    float ProductionBoost = 1.0f;
+    int32 ClassPath = INDEX_NONE; // Into the class paths: recipe of a machine, filter item of a smart splitter
+    int32 Row = INDEX_NONE;       // Row of the command, INDEX_NONE for shared buildables
+    EBuildable Type = EBuildable::Invalid;
+    uint8 bFlipped = 0;              // Rotated by 180°
+    int16 MachineClass = INDEX_NONE; // Into the class paths, the class of a custom machine
+};
+static_assert(sizeof(FPlannedBuildable) == 32, "FPlannedBuildable is stored as is in plan files");
+
+enum class EPlannedLink : uint8
+{
+    Belt, // Belt or lift, depending on the distance of the ports
+    Pipe,
+    PowerLine
+};
+
+// A connection component of a buildable: index into the components of the link's type
+struct FPlanPort
+{
+    int32 Buildable = INDEX_NONE;
+    int32 Port = 0;
+};
+
+struct FPlannedConnection
+{
+    int32 From = INDEX_NONE;
+    int32 To = INDEX_NONE;
+    uint8 FromPort = 0;
+    uint8 ToPort = 0;
+    EPlannedLink Type = EPlannedLink::Belt;
+    uint8 Tier = 0; // Belt or pipeline tier
+};
+static_assert(sizeof(FPlannedConnection) == 12, "FPlannedConnection is stored as is in plan files");
+
+// Smart splitters of a mixed input belt sort their filter item to the machine, everything else passes on
+constexpr int32 SmartSplitterPassPort = 0;
+constexpr int32 SmartSplitterMachinePort = 3;
+
+// Belts between ports with enough height difference and little horizontal distance become lifts
+inline bool ShouldUseLift(const FVector& From, const FVector& To)
+{
+    const float MinVerticalForLift = 400.0f;
+    const float MaxHorizontalForLift = 600.0f;
+    const FVector Distance = (From - To).GetAbs();
+    return Distance.Z >= MinVerticalForLift && Distance.X <= MaxHorizontalForLift &&
+           Distance.Y <= MaxHorizontalForLift;
+}
+
+// Read-only access to a plan, either generated or mapped from a file
+struct FBuildPlanView
+{
+    TConstArrayView<FPlannedBuildable> Buildables;
+    TConstArrayView<FPlannedConnection> Connections;
+    TConstArrayView<FString> ClassPaths; // Recipes, filter items of smart splitters and custom machine classes
+
+    // Class path of a custom machine, empty for every other buildable
+    const FString& GetMachineClassPath(const FPlannedBuildable& Buildable) const
+    {
+        static const FString None;
+        return ClassPaths.IsValidIndex(Buildable.MachineClass) ? ClassPaths[Buildable.MachineClass] : None;
+    }
+};
+
+/**
+ * Result of the layout: flat buildable records and the belts, pipes and power lines between them.
+ * Nothing is spawned yet, see FBuildPlanSpawner.
+ */
+struct FBuildPlan
+{
+    TArray<FPlannedBuildable> Buildables;
+    TArray<FPlannedConnection> Connections;
+    TArray<FString> ClassPaths;
+
+    FBuildPlan() = default;
+    explicit FBuildPlan(const FBuildPlanView& View);
+
+    int32 AddBuildable(EBuildable Type, const FVector& Location, bool bFlipped, int32 Row);
+    void Connect(EPlannedLink Type, const FPlanPort& From, const FPlanPort& To, int32 Tier = 0);
+    int32 AddClassPath(const FString& ClassPath);
+    void Reserve(int32 NumBuildables, int32 NumConnections);
+    void Reset();
+
+    FBuildPlanView GetView() const { return {Buildables, Connections, ClassPaths}; }
+
+    // Path of a saved plan in Saved/FactorySpawner, empty for invalid names
+    static FString GetSavePath(const FString& Name);
+
+    bool SaveToFile(const FString& Path, FString& OutError) const;
+};
+
+/**
+ * A plan file mapped into memory. The records are used in place, only the recipe names are converted.
+ */
+class FMappedBuildPlan
+{
+  public:
+    ~FMappedBuildPlan();
+
+    static TUniquePtr<FMappedBuildPlan> Open(const FString& Path, FString& OutError);
+
+    FBuildPlanView GetView() const { return {Buildables, Connections, ClassPaths}; }
+
+  private:
+    FMappedBuildPlan() = default;
+    bool Init(const uint8* Data, int64 Size, FString& OutError);
+
+    TUniquePtr<IMappedFileHandle> Handle;
+    TUniquePtr<IMappedFileRegion> Region; // Declared after the handle, so it is released first
+    TArray<uint8> FileData; // Fallback for platforms without memory mapping
+
+    TConstArrayView<FPlannedBuildable> Buildables;
+    TConstArrayView<FPlannedConnection> Connections;
+    TArray<FString> ClassPaths;
+};
+
+/**
+ * A finished plan shared by the spawn job and the plan history: a generated plan moved in, or a plan file that stays
+ * mapped. The records are never copied.
+ */
+class FSharedBuildPlan
+{
+  public:
+    explicit FSharedBuildPlan(FBuildPlan&& InPlan) : Plan(MoveTemp(InPlan)) {}
+    explicit FSharedBuildPlan(TUniquePtr<FMappedBuildPlan>&& InMapped) : Mapped(MoveTemp(InMapped)) {}
+
+    FBuildPlanView GetView() const { return Mapped ? Mapped->GetView() : Plan.GetView(); }
+
+  private:
+    FBuildPlan Plan;
+    TUniquePtr<FMappedBuildPlan> Mapped;
+};
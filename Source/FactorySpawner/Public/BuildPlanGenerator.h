@@ -2,26 +2,64 @@
 
 #include "CoreMinimal.h"
 #include "BuildPlanTypes.h"
+#include "ClockPlanner.h"
+#include "BuildPlan.h"
 
 class UBuildableCache;
-class AFGBuildable;
-class UFGPowerConnectionComponent;
-class UFGPipeConnectionComponent;
-class UFGFactoryConnectionComponent;
+struct FRecipeDescriptor;
+struct FMachinePorts;
 
-struct FCachedPowerConnections
+struct FPowerConsumer
 {
-    UFGPowerConnectionComponent* LastMachine = nullptr;
-    UFGPowerConnectionComponent* LastPole = nullptr;
-    UFGPowerConnectionComponent* FirstPole = nullptr;
+    int32 Machine = INDEX_NONE;
+    FVector PoleAnchor = FVector::ZeroVector;
+    int32 Group = 0;
+    bool bWallMount = false;
 };
 
-struct FConnectionQueue
+/**
+ * Relative arrangement of one machine with its splitters, mergers and crosses. A row computes its cell once and
+ * stamps it for every machine; only the manifold links between neighbouring cells depend on the position.
+ */
+struct FMachineCell
 {
-    TQueue<UFGFactoryConnectionComponent*> Input;
-    TQueue<UFGFactoryConnectionComponent*> Output;
-    TQueue<UFGPipeConnectionComponent*> PipeInput;
-    TQueue<UFGPipeConnectionComponent*> PipeOutput;
+    struct FCellBuildable
+    {
+        EBuildable Type = EBuildable::Invalid;
+        FVector Offset = FVector::ZeroVector; // From the machine
+        bool bFlipped = false;
+        int32 Filter = INDEX_NONE; // Solid ingredient a smart splitter sorts out to the machine
+    };
+
+    // Ports refer to Buildables of the cell
+    struct FCellLink
+    {
+        EPlannedLink Type = EPlannedLink::Belt;
+        FPlanPort From;
+        FPlanPort To;
+    };
+
+    // A splitter, merger or cross that continues the manifold of the previous cell
+    struct FManifold
+    {
+        EPlannedLink Type = EPlannedLink::Belt;
+        FPlanPort Open;  // Port the next cell connects to
+        FPlanPort Entry; // Port connected to the previous cell's open port
+        bool bTowardsPrevious = false; // Output manifolds flow back to the head of the row
+    };
+
+    TArray<FCellBuildable> Buildables; // The machine comes first
+    TArray<FCellLink> Links;
+    TArray<FManifold> Manifolds;
+    FVector PoleAnchor = FVector::ZeroVector;
+};
+
+// Upper bound of the records a command produces, so the plan is allocated once
+struct FPlanCapacity
+{
+    int32 Buildables = 0;
+    int32 Connections = 0;
+    int32 PowerConsumers = 0;
 };
 
 struct FConnector
@@ -65,6 +103,9 @@ inline FMachineConfig MakeMachineConfig(int32 Width, int32 Length,
     return {Width, Length, TArray<FMachineConnections>(Inputs), TArray<FMachineConnections>(Outputs)};
 }
 
+/**
+ * Lays out the rows of a command as a FBuildPlan; FBuildPlanSpawner turns the plan into buildables
+ */
 class FBuildPlanGenerator
 {
   public:
@@ -72,44 +113,89 @@ class FBuildPlanGenerator
 
     void Generate(const TArray<FFactoryCommandToken>& ClusterConfig);
 
+    // Adds the records of a row with a fixed machine count; rows planned by rate are not known before the layout
+    static void AddCapacity(const FFactoryCommandToken& RowConfig, UBuildableCache* Cache,
+                            FPlanCapacity& InOutCapacity);
+
+    // Incremental generation, for rows that arrive one by one (e.g. streamed from a file)
+    void Begin(const FPlanCapacity& Capacity = {});
+    void AddRow(const FFactoryCommandToken& RowConfig);
+    void Finish();
+    void Abort();
+
+    int32 GetNumRows() const { return NumRows; }
+    const FBuildPlan& GetPlan() const { return Plan; }
+
+    // Moves the finished plan out, the generator is empty afterwards
+    FBuildPlan TakePlan() { return MoveTemp(Plan); }
+
+    // Hand-made footprint and ports of a machine, nullptr for other buildables and machines without one.
+    // Layouts are looked up through UBuildableCache::GetMachineConfig, which checks these against the derived ones
+    static const FMachineConfig* FindMachineConfig(EBuildable MachineType);
+
+    /**
+     * Layout for a machine from its port positions and clearance box, for machines without a hand-made one.
+     * Ports are taken from left to right; each belt and pipe gets a lane level of its own.
+     */
+    static FMachineConfig DeriveMachineConfig(const FMachinePorts& Ports);
+
   private:
     void ProcessRow(const FFactoryCommandToken& RowConfig, int32 RowIndex);
-    void PlaceMachines(const FFactoryCommandToken& RowConfig, int32 Width, int32 Length,
-                       const FMachineConnections& InputConnections, const FMachineConnections& OutputConnections);
-    void CalculateMachineSetup(EBuildable MachineType, const TOptional<FString>& Recipe,
-                               const TOptional<float>& Underclock, int32 Width, int32 Length,
-                               const FMachineConnections& InputConnections,
-                               const FMachineConnections& OutputConnections, bool bFirstUnitInRow, bool bEvenIndex,
-                               bool bLastIndex);
-    void SpawnWireAndConnect(UFGPowerConnectionComponent* A, UFGPowerConnectionComponent* B);
-    UFGPowerConnectionComponent* SpawnPowerPole(const FVector& Location);
-    void SpawnMachine(const FVector& Location, EBuildable MachineType, const TOptional<FString>& Recipe,
-                      const TOptional<float>& Underclock, UFGPowerConnectionComponent*& outPowerConn,
-                      TArray<UFGFactoryConnectionComponent*>& outBeltConn,
-                      TArray<UFGPipeConnectionComponent*>& outPipeConn);
-    TArray<UFGFactoryConnectionComponent*> SpawnSplitterOrMerger(const FVector& Location, EBuildable SplitterOrMerger);
-    void SpawnLiftOrBeltAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To);
-    void SpawnBeltAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To);
-    void SpawnLiftAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To);
-    TArray<UFGPipeConnectionComponent*> SpawnPipeCross(const FVector& Location);
-    void SpawnPipeAndConnect(UFGPipeConnectionComponent* From, UFGPipeConnectionComponent* To);
+    bool PlanClocks(const FFactoryCommandToken& RowConfig, int32 RowIndex, float BaseRate, FClockPlan& OutPlan);
+    void PlanGeneratorRow(const FFactoryCommandToken& RowConfig, int32 RowIndex, const FMachineConfig& Config);
+    // Filter items of a mixed input belt per solid ingredient, empty if the row keeps one belt per ingredient
+    void PlanMixedInputs(int32 RowIndex, const FRecipeDescriptor& Descriptor, const FClockPlan& ClockPlan,
+                         TArray<int32>& OutFilterItems);
+    // Predicts output, fill-up time and starved machines of a production row and reports them with the summary
+    void SimulateRow(const FFactoryCommandToken& RowConfig, int32 RowIndex, const FRecipeDescriptor& Descriptor,
+                     const FClockPlan& ClockPlan, const FMachineConfig& Config, bool bMixedInputs);
+    // Foundations on a grid shared by all rows, covering the machines and manifolds of a row
+    void PlaceFloor(const FFactoryCommandToken& RowConfig, int32 RowIndex, const FBox2D& RowArea);
+    void PlaceMachines(const FFactoryCommandToken& RowConfig, int32 RowIndex, int32 Recipe,
+                       const FClockPlan& ClockPlan, const FMachineCell& Cell, int32 Width,
+                       TConstArrayView<int32> FilterItems);
+    const FMachineCell& GetMachineCell(EBuildable MachineType, const FString& MachineClass, int32 InputVariant,
+                                       int32 OutputVariant, bool bMixedInputs);
+    static FMachineCell BuildMachineCell(EBuildable MachineType, int32 Width, int32 Length,
+                                         const FMachineConnections& InputConnections,
+                                         const FMachineConnections& OutputConnections, const FMachinePorts& Ports,
+                                         bool bMixedInputs);
+    void StampMachineCell(const FMachineCell& Cell, int32 Recipe, int32 MachineClass, float ClockPercent,
+                          float ProductionBoost, EPowerScheme PowerScheme, int32 RowIndex, bool bFirstUnitInRow,
+                          TConstArrayView<int32> FilterItems);
+    void ConnectMachinePower(int32 Machine, const FVector& PoleAnchor, EPowerScheme PowerScheme, int32 RowIndex,
+                             bool bFirstUnitInRow);
+    void PlanPowerNetwork();
 
   private:
     // Core references
     UWorld* World;
     UBuildableCache* Cache;
-    AFGCharacterPlayer* Player = nullptr;
-    UFGManufacturerClipboardRCO* RCO = nullptr;
 
-    // Blueprint output
-    TArray<AFGBuildable*> BuildablesForBlueprint;
+    // Output
+    FBuildPlan Plan;
 
     // Layout state
+    int32 NumRows = 0;
     int32 YCursor = 0;
     int32 XCursor = 0;
     int32 FirstMachineWidth = 0;
 
+    // Tiers chosen for the command; generator rows may use smaller manifolds
+    int32 BeltTier = 1;
+    int32 PipelineTier = 1;
+    int32 RowBeltTier = 1;
+    int32 RowPipelineTier = 1;
+    float TotalPowerOutput = 0.0f;
+
     // Connection state
-    FCachedPowerConnections CachedPowerConnections;
-    FConnectionQueue ConnectionQueue;
+    TArray<FPowerConsumer> PowerConsumers;
+    int32 LastMachine = INDEX_NONE;
+    TArray<FPlanPort, TInlineAllocator<8>> ManifoldEnds; // Open port of each manifold at the previous machine
+
+    // Foundation tiles placed so far, rows next to each other share their border tiles
+    TSet<FIntPoint> FloorTiles;
+
+    // Cells by machine class and port variants, built on first use
+    TMap<TPair<UClass*, uint32>, FMachineCell> MachineCells;
 };
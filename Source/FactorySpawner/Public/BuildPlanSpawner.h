@@ -0,0 +1,110 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlan.h"
+
+class UBuildableCache;
+class UFGRecipe;
+class UFGItemDescriptor;
+class AFGBuildable;
+class AFGCharacterPlayer;
+class AFGPlayerController;
+class UFGManufacturerClipboardRCO;
+class UFGPowerConnectionComponent;
+class UFGPipeConnectionComponent;
+class UFGFactoryConnectionComponent;
+
+/**
+ * Spawns the buildables of a plan, writes them into a blueprint and removes them again.
+ * The work can be split over several frames with Step, so a large plan does not stall the server.
+ */
+class FBuildPlanSpawner
+{
+  public:
+    // Settings are pasted as Instigator; without one (server console) the first player controller is used
+    FBuildPlanSpawner(UWorld* InWorld, UBuildableCache* InCache, AFGPlayerController* Instigator,
+                      const FString& InBlueprintName);
+
+    // Keeps a reference to the plan and captures the current belt and pipe classes, nothing is spawned yet
+    void Begin(const TSharedRef<const FSharedBuildPlan>& InPlan);
+
+    // Spawns until the deadline (FPlatformTime::Seconds), true once the blueprint is written
+    bool Step(double Deadline);
+
+    // Begin and all steps at once
+    void Spawn(const TSharedRef<const FSharedBuildPlan>& InPlan);
+
+    // Builds the plan into the world at Placement and keeps it there, instead of writing the blueprint
+    void SetPlacement(const FTransform& InPlacement);
+    bool IsPlacing() const { return bPlaceInWorld; }
+    const FTransform& GetPlacement() const { return Placement; }
+
+    // Removes everything spawned so far; the blueprint is only written by the last step and stays untouched
+    void Cancel();
+
+    // Share of the plan's buildables and connections spawned so far (0 - 1)
+    float GetProgress() const;
+
+    // Wall time per phase in seconds, added up over all steps
+    struct FTimings
+    {
+        double Spawn = 0.0;
+        double Blueprint = 0.0;
+        double Destroy = 0.0;
+    };
+    const FTimings& GetTimings() const { return Timings; }
+
+    const FBuildPlanView& GetPlan() const { return Plan; }
+    int32 GetNumRecords() const { return Plan.Buildables.Num() + Plan.Connections.Num(); }
+    const FString& GetBlueprintName() const { return BlueprintName; }
+
+  private:
+    void WriteBlueprint();
+    void ConvertToLightweight();
+    void DestroyBuildables();
+    void AddSpawned(AFGBuildable* Buildable);
+
+    AFGBuildable* SpawnBuildable(const FPlannedBuildable& Buildable);
+    AFGBuildable* SpawnMachine(const FPlannedBuildable& Buildable, const FTransform& Transform);
+    AFGBuildable* SpawnGenerator(const FPlannedBuildable& Buildable, const FTransform& Transform);
+    AFGBuildable* SpawnSmartSplitter(const FPlannedBuildable& Buildable, const FTransform& Transform);
+    void SpawnConnection(const FPlannedConnection& Connection);
+
+    void SpawnWireAndConnect(UFGPowerConnectionComponent* A, UFGPowerConnectionComponent* B);
+    void SpawnLiftOrBeltAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To,
+                                   int32 Tier);
+    void SpawnBeltAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To, int32 Tier);
+    void SpawnLiftAndConnect(UFGFactoryConnectionComponent* From, UFGFactoryConnectionComponent* To, int32 Tier);
+    void SpawnPipeAndConnect(UFGPipeConnectionComponent* From, UFGPipeConnectionComponent* To, int32 Tier);
+
+  private:
+    // Core references
+    UWorld* World;
+    UBuildableCache* Cache;
+    AFGCharacterPlayer* Player = nullptr;
+    UFGManufacturerClipboardRCO* RCO = nullptr;
+    FString BlueprintName;
+    FTransform Placement = FTransform::Identity;
+    bool bPlaceInWorld = false;
+
+    TSharedPtr<const FSharedBuildPlan> SharedPlan; // Keeps the records of Plan alive
+    FBuildPlanView Plan;
+    int32 NextBuildable = 0;
+    int32 NextConnection = 0;
+    FTimings Timings;
+
+    // Belt, lift and pipe classes per tier (index 0 is the command's tier, used for untiered edges)
+    TSubclassOf<AFGBuildable> BeltClasses[7];
+    TSubclassOf<AFGBuildable> LiftClasses[7];
+    TSubclassOf<AFGBuildable> PipeClasses[3];
+
+    // Spawned actor per buildable record, taken from the cache's pool. Weak, because a placed buildable can be
+    // dismantled by a player while the job still runs
+    TArray<TWeakObjectPtr<AFGBuildable>> SpawnedBuildables;
+    TArray<TSubclassOf<UFGRecipe>> RecipeClasses;
+    TArray<TSubclassOf<UFGItemDescriptor>> ItemClasses; // Smart splitter filters, same index as RecipeClasses
+
+    // Blueprint output: the pooled buildables first, then belts, lifts, pipes and wires
+    TArray<TWeakObjectPtr<AFGBuildable>> BuildablesForBlueprint;
+    int32 NumPooledBuildables = 0;
+};
@@ -17,6 +17,7 @@ enum class EBuildable : uint8
     ParticleAccelerator,
     QuantumEncoder,
     Packager,
+    CustomMachine, // Any other production building, given by class path (e.g. from a mod)
 
     // Generators
     CoalGenerator,
@@ -26,7 +27,11 @@ enum class EBuildable : uint8
     // Utility
     Splitter,
     Merger,
+    SmartSplitter,
     PowerPole,
+    PowerPoleMk2,
+    PowerPoleMk3,
+    PowerWallOutlet,
     Pipeline,
     Pipeline2,
     PipeCross,
@@ -36,14 +41,72 @@ enum class EBuildable : uint8
     Lift,
     PowerLine,
 
+    // Building, placed as lightweight instances
+    Foundation1m,
+    Foundation2m,
+    Foundation4m,
+    Wall,
+
     Invalid
 };
 
+inline bool IsGenerator(EBuildable Type)
+{
+    return Type == EBuildable::CoalGenerator || Type == EBuildable::FuelGenerator ||
+           Type == EBuildable::NuclearReactor;
+}
+
+inline bool IsFoundation(EBuildable Type)
+{
+    return Type >= EBuildable::Foundation1m && Type <= EBuildable::Foundation4m;
+}
+
+inline bool IsLightweight(EBuildable Type)
+{
+    return Type >= EBuildable::Foundation1m && Type <= EBuildable::Wall;
+}
+
+// Throughput of a conveyor belt Mk1 - Mk6 in items per minute
+inline float GetBeltThroughput(int32 Tier)
+{
+    static const float Throughput[] = {60.0f, 120.0f, 270.0f, 480.0f, 780.0f, 1200.0f};
+    return Throughput[FMath::Clamp(Tier, 1, 6) - 1];
+}
+
+// Throughput of a pipeline Mk1 - Mk2 in m³ per minute
+inline float GetPipeThroughput(int32 Tier)
+{
+    return Tier >= 2 ? 600.0f : 300.0f;
+}
+
+// How the machines of a row get their power
+enum class EPowerScheme : uint8
+{
+    Poles,       // Free-standing poles shared by neighbouring machines
+    WallOutlets, // Machines daisy-chained from one wall outlet, on a wall at the head of the row
+    Chained      // Machines daisy-chained, the first machines of all rows share free-standing poles
+};
+
 struct FFactoryCommandToken
 {
     int32 Count = 0;
     EBuildable MachineType;
+    FString MachineClass; // Class path of a CustomMachine row
     TOptional<FString> Recipe;
-    TOptional<float> ClockPercent; // percent value (e.g. 75.5)
+    TOptional<float> ClockPercent; // percent value (e.g. 75.5), the maximum clock if TargetRate is set
+    TOptional<float> TargetRate;   // optional output per minute (rate=N), Count is then the maximum (0 = no limit)
+    int32 Somersloops = 0;         // somersloops available for the row (sloops=N)
+    int32 MinMachines = 0;         // lowest count of machines=A-B, plans for least power instead of fewest machines
+    bool bMixedInputs = false;     // all solid ingredients on one belt, sorted by smart splitters (inputs=mixed)
     TOptional<int32> BeltTier;     // optional belt tier override (1-6 for Mk1-Mk6)
+    EPowerScheme PowerScheme = EPowerScheme::Poles;
+    int32 FloorHeight = 0;         // m, foundations under the row (floor 1|2|4), 0 for none
+};
+
+// Command-level options, given once and applied to every row
+struct FFactoryCommandOptions
+{
+    TOptional<int32> BeltTier;
+    EPowerScheme PowerScheme = EPowerScheme::Poles;
+    int32 FloorHeight = 0;
 };
@@ -2,11 +2,13 @@
 
 #include "CoreMinimal.h"
 #include "BuildPlanTypes.h"
+#include "BuildPlanGenerator.h"
 #include "BuildableCache.generated.h"
 
 class AFGBuildable;
 class AFGBuildableManufacturer;
 class UFGRecipe;
+class UFGItemDescriptor;
 
 USTRUCT()
 struct FWrongRecipe
@@ -20,6 +22,91 @@ struct FWrongRecipe
     FString ProducedIn;
 };
 
+USTRUCT()
+struct FRecipeItemRate
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TSubclassOf<UFGItemDescriptor> Item;
+
+    float PerMinute = 0.0f; // At 100%, fluids in m³
+    bool bFluid = false;
+};
+
+/**
+ * Everything the generator needs to know about a recipe in a machine. Rates and port counts are computed once per
+ * recipe class, the port variants for each machine layout they are asked for.
+ */
+USTRUCT()
+struct FRecipeDescriptor
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TArray<FRecipeItemRate> Ingredients;
+
+    UPROPERTY()
+    TArray<FRecipeItemRate> Products;
+
+    int32 SolidIn = 0;
+    int32 FluidIn = 0;
+    int32 SolidOut = 0;
+    int32 FluidOut = 0;
+    float Duration = 0.0f; // Seconds per cycle at 100%
+
+    // Index into FMachineConfig::InputConnections / OutputConnections
+    int32 InputVariant = 0;
+    int32 OutputVariant = 0;
+
+    // Output of the main product per minute at 100%
+    float GetBaseRate() const { return Products.IsEmpty() ? 0.0f : Products[0].PerMinute; }
+};
+
+// Hidden buildables of one class, kept between commands instead of destroyed
+USTRUCT()
+struct FBuildablePool
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TArray<AFGBuildable*> Free;
+};
+
+// Connection components of a machine relative to the actor, indexed like FPlanPort::Port
+struct FMachinePorts
+{
+    TArray<FVector> Belt;
+    TArray<FVector> Pipe;
+    TArray<bool> BeltIsInput;
+    TArray<bool> PipeIsInput;
+    FBox Footprint = FBox(ForceInit); // Clearance box relative to the actor
+
+    // Layout derived from the ports and footprint, for machines the generator has no hand-made layout for
+    FMachineConfig DerivedConfig;
+
+    // The hand-made layout of the machine type if there is one, else DerivedConfig; nullptr without a footprint
+    const FMachineConfig* Config = nullptr;
+};
+
+// A recipe (or generator fuel) used by a row of a command
+struct FRecipeRequest
+{
+    EBuildable Machine = EBuildable::Invalid;
+    FString Recipe;
+    FString MachineClass; // Class path of a CustomMachine
+
+    bool operator==(const FRecipeRequest& Other) const
+    {
+        return Machine == Other.Machine && Recipe == Other.Recipe && MachineClass == Other.MachineClass;
+    }
+    friend uint32 GetTypeHash(const FRecipeRequest& Request)
+    {
+        return HashCombine(HashCombine(GetTypeHash(Request.Machine), GetTypeHash(Request.Recipe)),
+                           GetTypeHash(Request.MachineClass));
+    }
+};
+
 /**
  * Helper class for lazy-loading and caching buildable classes, recipes, and meshes
  */
@@ -33,9 +120,19 @@ class FACTORYSPAWNER_API UBuildableCache : public UObject
     template <typename T>
     TSubclassOf<T> GetBuildableClass(EBuildable Type);
 
+    // Class of a machine or generator; a CustomMachine is loaded from ClassPath
+    TSubclassOf<AFGBuildable> GetMachineClass(EBuildable Type, const FString& ClassPath = FString());
+
+    // Belt, lift or pipeline class of a given tier, without changing the current one
+    TSubclassOf<AFGBuildable> GetTieredClass(EBuildable Type, int32 Tier);
+
     void SetBeltClass(int32 Tier);
     void SetLiftClass(int32 Tier);
     void SetPipelineClass(int32 Tier);
+    void SetPowerPoleTier(int32 Tier);
+    int32 GetMaxPowerPoleTier() const { return MaxPowerPoleTier; }
+    int32 GetBeltTier() const { return BeltTier; }
+    int32 GetPipelineTier() const { return PipelineTier; }
     
     // Get the highest unlocked belt tier (1-6), defaults to 1 if none found
     int32 GetHighestUnlockedBeltTier(UWorld* World);
@@ -43,20 +140,104 @@ class FACTORYSPAWNER_API UBuildableCache : public UObject
     // Get the highest unlocked pipeline tier (1-2), defaults to 1 if none found
     int32 GetHighestUnlockedPipelineTier(UWorld* World);
 
+    // Get the highest unlocked power pole tier (1-3), defaults to 1 if none found
+    int32 GetHighestUnlockedPowerPoleTier(UWorld* World);
+
     // Recipe loader
     TSubclassOf<UFGRecipe> GetRecipeClass(const FString& Recipe, TSubclassOf<AFGBuildableManufacturer> ProducedIn,
                                                  UWorld* World);
 
+    /**
+     * Resolves all distinct recipes of a command up front, with one recipe list lookup per machine.
+     * Unknown recipes and fuels are all reported in OutErrors.
+     */
+    bool ResolveRecipes(const TSet<FRecipeRequest>& Requests, UWorld* World, TArray<FString>& OutErrors);
+
+    // Recipe names resolved in earlier sessions; entries are used once the recipe manager confirms them
+    void LoadRecipeIndex();
+
+    // Port counts, rates and the port variants of Config for a recipe, a copy that stays valid
+    FRecipeDescriptor GetRecipeDescriptor(TSubclassOf<UFGRecipe> Recipe, const FMachineConfig& Config);
+
+    // Recipe the build gun uses for a buildable, nullptr if it is not unlocked
+    TSubclassOf<UFGRecipe> GetBuildRecipe(TSubclassOf<AFGBuildable> Buildable, UWorld* World);
+
+    // Where the belt and pipe ports of a machine are, read once per class from the class defaults
+    const FMachinePorts& GetMachinePorts(EBuildable Type, const FString& ClassPath = FString());
+
+    // Hand-made layout of the generator, or the one derived from the class defaults; nullptr for other buildables
+    // and machines without a class. Stays valid until the cache is cleared
+    const FMachineConfig* GetMachineConfig(EBuildable Type, const FString& ClassPath = FString());
+
+    // Width and length of a machine's layout in meters, zero for other buildables
+    FIntPoint GetMachineSize(EBuildable Type, const FString& ClassPath = FString());
+
+    // Warns once per class if the ports of a spawned machine are not in the order read from the class defaults,
+    // derived layouts connect by that order
+    void CheckPortOrder(EBuildable Type, const FString& ClassPath, const AFGBuildable* Buildable);
+
+    // Pooled buildables and those of jobs that are not finished yet; they are left out of savegames
+    static const FName UnsavedTag;
+
+    // Buildable pool: reuses hidden machines, splitters, mergers, crosses and poles of earlier commands
+    AFGBuildable* AcquireBuildable(UWorld* World, TSubclassOf<AFGBuildable> Class, const FTransform& Transform);
+
+    // Disconnects and hides a buildable for the next command, false if the pool is full and it has to be destroyed
+    bool ReleaseBuildable(AFGBuildable* Buildable);
+
+    // Destroys all pooled buildables once they have not been needed for a while
+    void DrainPool();
+
     void ClearCache();
 
   private:
+    static FString GetRecipeKey(const FString& ProducedInName, const FString& Recipe);
+
+    // Recipe of the index if it is still available and produced in ProducedIn, dropped from the index otherwise
+    TSubclassOf<UFGRecipe> FindIndexedRecipe(const FString& Key, TSubclassOf<AFGBuildableManufacturer> ProducedIn,
+                                             UWorld* World);
+    void AddRecipeClass(const FString& Key, TSubclassOf<UFGRecipe> Recipe);
+    void SaveRecipeIndex();
+    static TSubclassOf<UFGRecipe> FindRecipe(const FString& Recipe,
+                                             const TArray<TSubclassOf<UFGRecipe>>& AvailableRecipes);
+    static FString GetAvailableRecipesMessage(const FString& ProducedInName,
+                                              const TArray<TSubclassOf<UFGRecipe>>& AvailableRecipes);
+
     // Instance-level caches
     UPROPERTY()
     TMap<EBuildable, TSubclassOf<AFGBuildable>> CachedClasses;
 
+    // Keyed by "<machine class>/<recipe>", the same name may mean different recipes in different machines
     UPROPERTY()
     TMap<FString, TSubclassOf<UFGRecipe>> CachedRecipeClasses;
 
     UPROPERTY()
     TArray<FWrongRecipe> WrongRecipes;
+
+    // Recipe class paths by recipe key, from RecipeIndex.json and this session
+    TMap<FString, FString> IndexedRecipes;
+    bool bRecipeIndexChanged = false;
+
+    // Without port variants, they depend on the machine layout
+    UPROPERTY()
+    TMap<TSubclassOf<UFGRecipe>, FRecipeDescriptor> RecipeRates;
+
+    UPROPERTY()
+    TMap<TSubclassOf<AFGBuildable>, TSubclassOf<UFGRecipe>> BuildRecipes;
+    bool bBuildRecipesLoaded = false;
+
+    UPROPERTY()
+    TMap<TSubclassOf<AFGBuildable>, FBuildablePool> Pools;
+
+    // Keyed by class path, nullptr for paths that did not load
+    UPROPERTY()
+    TMap<FString, TSubclassOf<AFGBuildable>> CustomMachineClasses;
+
+    // Boxed, so that the layouts handed out stay put while other classes are added
+    TMap<TSubclassOf<AFGBuildable>, TUniquePtr<FMachinePorts>> MachinePorts;
+    TSet<TSubclassOf<AFGBuildable>> CheckedPortOrders;
+
+    int32 BeltTier = 1;
+    int32 PipelineTier = 1;
+    int32 MaxPowerPoleTier = 1;
 };
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlanTypes.h"
+
+// Machine count, clock and production amplification for one row
+struct FClockPlan
+{
+    int32 MachineCount = 0;
+    float ClockPercent = 100.0f;  // Same clock for every machine of the row
+    float LastClockPercent = 0.0f; // Clock of the last machine if it runs slower than the rest, 0 otherwise
+    int32 PowerShardsPerMachine = 0;
+    TArray<int32> Somersloops;    // Per machine, filled from the first machine on
+    float OutputRate = 0.0f;      // Items (or m³) per minute of the main product
+    float PowerUsage = 0.0f;      // MW
+
+    float GetProductionBoost(int32 MachineIndex, int32 Slots) const;
+    float GetClockPercent(int32 MachineIndex) const;
+};
+
+/**
+ * Decides machine count, overclock (power shards) and somersloop placement for a target production rate
+ */
+class FClockPlanner
+{
+  public:
+    static constexpr float MaxClockPercent = 250.0f;
+
+    // Upper bound for rows planned by rate, so a huge rate cannot stall the layout
+    static constexpr int32 MaxMachinesPerRow = 1000;
+
+    // Somersloop slots of a production machine (0 for generators)
+    static int32 GetSomersloopSlots(EBuildable Machine);
+
+    // Power usage in MW at 100% (average for machines with variable power usage)
+    static float GetPowerConsumption(EBuildable Machine);
+
+    static int32 GetPowerShardsForClock(float ClockPercent);
+    static float GetMachinePower(EBuildable Machine, float ClockPercent, float ProductionBoost);
+
+    /**
+     * Plans the fewest machines that reach the target rate: somersloops double the output of a fully slotted
+     * machine, power shards raise the clock up to MaxClock. All machines share one clock. The count is computed
+     * directly, not searched.
+     *
+     * @param BaseRate Output of one machine at 100% without amplification (per minute)
+     * @param MaxMachines Upper bound for the machine count
+     * @param Somersloops Somersloops available for the row
+     * @return false if the target cannot be reached, OutPlan then holds the best effort
+     */
+    static bool PlanForRate(EBuildable Machine, float BaseRate, float TargetRate, int32 MaxMachines, float MaxClock,
+                            int32 Somersloops, FClockPlan& OutPlan);
+
+    /**
+     * Plans the machine count within [MinMachines, MaxMachines] and the clocks that reach the target rate with the
+     * least power. Each count is tried with one clock for all machines and with all but the last machine at 100%
+     * (or MaxClock if lower) and the last one running the remainder. Ties go to fewer machines.
+     *
+     * @return false if no count in the range reaches the target, OutPlan then holds the best effort of PlanForRate
+     */
+    static bool PlanForPower(EBuildable Machine, float BaseRate, float TargetRate, int32 MinMachines,
+                             int32 MaxMachines, float MaxClock, int32 Somersloops, FClockPlan& OutPlan);
+
+    // Fills power usage and output of a fixed plan (count, clock, somersloops)
+    static void Evaluate(EBuildable Machine, float BaseRate, FClockPlan& Plan);
+};
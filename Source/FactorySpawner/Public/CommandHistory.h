@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlan.h"
+
+/**
+ * Size and timings of one command, from typing it to the written blueprint (or placed factory).
+ * Phases are wall time in milliseconds; spawning, blueprint and destroy add up over all frames of the job.
+ */
+struct FCommandRecord
+{
+    FString Kind; // command, dryrun, place, file or load
+    uint32 CommandHash = 0;
+    int32 Rows = 0;
+    int32 Machines = 0;
+    int32 Buildables = 0;
+    int32 Connections = 0;
+    TMap<EBuildable, int32> BuildablesPerType;
+
+    double ParseMs = 0.0;
+    double RecipesMs = 0.0;
+    double PlanMs = 0.0;
+    double SpawnMs = 0.0;
+    double BlueprintMs = 0.0;
+    double DestroyMs = 0.0;
+
+    uint64 MemoryAtStart = 0; // Used physical memory in bytes
+    uint64 PeakMemory = 0;
+    double PhaseStart = 0.0;
+
+    FCommandRecord() = default;
+    FCommandRecord(const FString& InKind, const FString& Command);
+
+    // Adds the time since the previous phase ended (or the record was created) to PhaseMs
+    void EndPhase(double& PhaseMs);
+
+    // Counts rows, machines and buildables per type
+    void SetPlan(const FBuildPlanView& Plan);
+
+    // Keeps the highest memory use seen so far; called after every phase and spawn step
+    void SampleMemory();
+};
+
+/**
+ * Performance history of all commands in Saved/FactorySpawner/History.csv, to compare game and mod versions.
+ * The file is rolled over to History.1.csv once it gets large.
+ */
+class FCommandHistory
+{
+  public:
+    // Appends one line; Result is "done", "cancelled", "blocked" (placement taken meanwhile) or "dryrun"
+    static void Append(const FCommandRecord& Record, const TCHAR* Result);
+
+    static FString GetPath();
+};
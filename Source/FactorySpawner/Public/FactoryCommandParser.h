@@ -1,11 +1,22 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "BuildPlanTypes.h"
 
 class FFactoryCommandParser
 {
   public:
     // Parses a command like: "2 Smelter IngotIron 75, 3 Constructor IronPlate, beltTier 3"
+    // Rows take optional options: "auto Constructor IronPlate rate=90 sloops=2" plans count, clock and sloops
     // The beltTier parameter is optional and applies to all machines in the command
+    // An optional "power poles|wall|chain" group picks the power scheme for all rows
+    // An optional "floor 1|2|4" group puts foundations of that height under every row
     static bool ParseCommand(const FString& Input, TArray<FFactoryCommandToken>& OutTokens, FString& OutError);
+
+    // Parses a single comma-separated group. Rows are returned in OutRow, command-level groups ("beltTier 3",
+    // "power wall") update InOutOptions instead.
+    static bool ParseGroup(const FString& Group, int32 GroupIndex, FFactoryCommandOptions& InOutOptions,
+                           TOptional<FFactoryCommandToken>& OutRow, FString& OutError);
+
+    static void ApplyOptions(const FFactoryCommandOptions& Options, FFactoryCommandToken& Token);
 };
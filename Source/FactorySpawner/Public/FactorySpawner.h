@@ -5,9 +5,27 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogFactorySpawner, Verbose, All);
 
+class UCommandSender;
+
 class FFactorySpawnerModule : public IModuleInterface
 {
   public:
+    virtual void StartupModule() override;
+
     // Logging function, so that the user sees it in the chat window
     static void ChatLog(UWorld* World, const FString& Message);
+
+    // While a command runs, its ChatLog messages only go to the player who issued it
+    class FScopedChatTarget
+    {
+      public:
+        explicit FScopedChatTarget(UCommandSender* Sender);
+        ~FScopedChatTarget();
+
+      private:
+        UCommandSender* Previous;
+    };
+
+  private:
+    static UCommandSender* ChatTarget;
 };
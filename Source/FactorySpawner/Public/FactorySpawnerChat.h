@@ -3,10 +3,29 @@
 #include "CoreMinimal.h"
 #include "Command/ChatCommandInstance.h"
 #include "BuildPlanTypes.h"
+#include "BuildPlan.h"
+#include "BuildPlanSpawner.h"
+#include "CommandHistory.h"
+#include "UObject/StrongObjectPtr.h"
 #include "FactorySpawnerChat.generated.h"
 
 class UBuildPlanGenerator;
 class UBuildableCache;
+struct FRecipeRequest;
+class UCommandSender;
+
+// A plan that is spawned a few milliseconds per frame for the player who issued the command
+struct FSpawnJob
+{
+    int32 Id = 0;
+    FString Owner;
+    TStrongObjectPtr<UCommandSender> Sender;
+    TUniquePtr<FBuildPlanSpawner> Spawner;
+    double StartTime = 0.0;
+    int32 ReportedQuarters = 0;
+    bool bCheckPlacement = false; // Clearance is checked again before the first step, the spot may be taken by then
+    FCommandRecord Record;
+};
 
 UCLASS()
 class FACTORYSPAWNER_API AFactorySpawnerChat : public AChatCommandInstance
@@ -21,6 +40,7 @@ class FACTORYSPAWNER_API AFactorySpawnerChat : public AChatCommandInstance
 
     void BeginPlay() override;
     void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+    void Tick(float DeltaSeconds) override;
 
     EExecutionStatus ExecuteCommand_Implementation(class UCommandSender* Sender, const TArray<FString>& Arguments,
                                                    const FString& Label) override;
@@ -29,7 +49,72 @@ class FACTORYSPAWNER_API AFactorySpawnerChat : public AChatCommandInstance
     void ResetSubsystemData();
 
   private:
+    /** Spawns the rows of a plan file from Saved/FactorySpawner or Config/FactorySpawner */
+    EExecutionStatus ExecuteFileCommand(class UCommandSender* Sender, const FString& Name);
+
+    /** Spawns a plan saved with "save <name> <command>" */
+    EExecutionStatus ExecuteLoadCommand(class UCommandSender* Sender, const FString& Name);
+
+    /** Compares the last two plans */
+    EExecutionStatus ExecuteDiffCommand(class UCommandSender* Sender);
+
+    /** Lists the sender's jobs (status) or every player's jobs (queue) */
+    EExecutionStatus ExecuteStatusCommand(class UCommandSender* Sender, bool bAllPlayers);
+
+    /** Cancels the sender's newest job, a job by number or all jobs; other players' jobs need the host */
+    EExecutionStatus ExecuteCancelCommand(class UCommandSender* Sender, const FString& Which);
+
+    /** Host or server console */
+    static bool IsAdmin(class UCommandSender* Sender);
+
+    /**
+     * Queues a plan to be spawned into the sender's blueprint (or placed in the world) and keeps it for diff.
+     * Unless forced, the placement is cleared again when the job starts.
+     */
+    void SpawnPlan(class UCommandSender* Sender, const TSharedRef<const FSharedBuildPlan>& Plan,
+                   FCommandRecord&& Record, const TOptional<FTransform>& Placement = {},
+                   bool bForcePlacement = false);
+
+    /** Adds the spawn timings of a finished or cancelled job to the performance history */
+    static void RecordJob(FSpawnJob& Job, const TCHAR* Result);
+
+    /** Where the sender looks at, snapped to whole meters and a 90° yaw unless Yaw is given */
+    bool GetAimPlacement(class UCommandSender* Sender, const TOptional<float>& Yaw, FTransform& OutPlacement);
+
+    /**
+     * Checks the placed plan against existing buildables and moves it to the nearest free spot if needed.
+     * False (with a report of the conflicts) if there is none close by.
+     */
+    bool ClearPlacement(class UCommandSender* Sender, const FBuildPlanView& Plan, FTransform& InOutPlacement);
+
+    /** Runs a slice of the job of the player who was served longest ago */
+    void StepJobs();
+
+    /** Records and removes a job that is done or could not start */
+    void FinishJob(int32 JobIndex, const TCHAR* Result);
+
+    void SavePlan(class UCommandSender* Sender, const FString& Name, const FBuildPlan& Plan);
+
+    static void AddRecipeRequest(const FFactoryCommandToken& Row, TSet<FRecipeRequest>& InOutRecipes);
+
+    /** Resolves all recipes of a command at once and reports every unknown one, false if there were any */
+    bool ResolveRecipes(class UCommandSender* Sender, const TSet<FRecipeRequest>& Recipes);
+
+    /** Picks belt, pipeline and power pole tiers (explicit belt tier or highest unlocked) */
+    void SetupTiers(class UCommandSender* Sender, const TOptional<int32>& BeltTierOverride);
+
     /** Cache for buildables and recipes (world-specific) */
     UPROPERTY()
     UBuildableCache* BuildableCache;
+
+    /** The last two spawned plans per player, oldest first; shared with their spawn jobs */
+    TMap<FString, TArray<TSharedRef<const FSharedBuildPlan>>> RecentPlans;
+
+    /** Spawn jobs in order of arrival; players take turns, each player's jobs run in order */
+    TArray<TUniquePtr<FSpawnJob>> Jobs;
+    TMap<FString, double> LastServed;
+    int32 NextJobId = 1;
+
+    /** Destroys the pooled buildables once no command has run for a while */
+    FTimerHandle DrainPoolTimer;
 };
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlanTypes.h"
+
+struct FGeneratorFuel
+{
+    FString Name;                // Item name as typed in the command (e.g. "Coal", "Turbofuel")
+    EBuildable Generator;        // Generator that burns this fuel
+    bool bLiquid = false;        // Fuel arrives through a pipe instead of a belt
+    float FuelPerMinute = 0.0f;  // Items (or m³) per generator at 100%
+    float WaterPerMinute = 0.0f; // m³ of water per generator at 100%
+    float WastePerMinute = 0.0f; // Nuclear waste per generator at 100%
+};
+
+// Consumption and output of one generator row
+struct FGeneratorRowEstimate
+{
+    const FGeneratorFuel* Fuel = nullptr;
+    int32 Count = 0;
+    float FuelPerMinute = 0.0f;
+    float WaterPerMinute = 0.0f;
+    float WastePerMinute = 0.0f;
+    float PowerOutput = 0.0f; // MW
+};
+
+/**
+ * Static fuel table for the Coal Generator, Fuel Generator and Nuclear Power Plant
+ */
+class FGeneratorFuels
+{
+  public:
+    // Power output in MW of one generator at 100%
+    static float GetPowerOutput(EBuildable Generator);
+
+    static const FGeneratorFuel* Find(EBuildable Generator, const FString& Fuel);
+    static TArray<FString> GetFuelNames(EBuildable Generator);
+
+    // Fuel, water, waste and power all scale linearly with the clock
+    static FGeneratorRowEstimate Estimate(EBuildable Generator, const FGeneratorFuel* Fuel, int32 Count,
+                                          float ClockPercent = 100.0f);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlan.h"
+
+struct FOverlapResult;
+class UBuildableCache;
+
+// A buildable of the plan that would overlap something already built
+struct FClearanceConflict
+{
+    int32 Buildable = INDEX_NONE; // Index into the plan's buildables
+    FString Obstacle;             // Class or mesh name of what is in the way
+};
+
+/**
+ * Checks a plan placed in the world against existing buildables before anything is spawned.
+ * The footprints of machines, attachments and poles are hashed into a uniform grid of foundation-sized cells;
+ * the world is queried once per occupied cell and only the buildables of blocked cells are tested one by one.
+ * Belts, pipes and power lines are not checked, the build gun lets them pass through most things. Neither are
+ * foundations, which usually go onto or into an existing floor.
+ */
+class FPlanClearance
+{
+  public:
+    FPlanClearance(UWorld* InWorld, UBuildableCache* Cache, const FBuildPlanView& Plan);
+
+    // True if nothing is in the way at Placement; OutConflicts gets every blocked buildable instead of the first
+    bool Check(const FTransform& Placement, TArray<FClearanceConflict>* OutConflicts = nullptr);
+
+    // Nearest clear placement within MaxSteps cells around Placement (same rotation and height), not Placement itself
+    bool FindClearPlacement(const FTransform& Placement, int32 MaxSteps, FTransform& OutPlacement);
+
+    static constexpr float CellSize = 800.0f;
+
+  private:
+    // Footprint of a buildable relative to the plan origin, invalid for types that are not checked
+    static FBox GetLocalBox(const FPlannedBuildable& Buildable, const FString& MachineClass, UBuildableCache* Cache);
+
+    // Built buildables and lightweight foundations or walls, not landscape, foliage or pawns
+    static bool IsStructure(const FOverlapResult& Overlap, FString* OutName = nullptr);
+
+    // One world query per cell, cached while the height range of the plan stays the same
+    bool IsCellBlocked(const FIntPoint& Cell, float MinZ, float MaxZ);
+    bool IsBoxBlocked(const FBox& Box, FString* OutName);
+
+    UWorld* World;
+    TArray<FBox> LocalBoxes;
+
+    TMap<FIntPoint, bool> BlockedCells;
+    FVector2D CachedZRange = FVector2D::ZeroVector;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlan.h"
+
+/**
+ * Compares plans independently of the order in which their records were generated
+ */
+class FPlanDiff
+{
+  public:
+    // Content hash over the sorted buildable records and connections, stable across sessions and record order
+    static uint64 GetHash(const FBuildPlanView& Plan);
+
+    /**
+     * Compact report of what changed from Old to New: buildables and connections added or removed per type,
+     * and per row changed machine types, counts, recipes and clocks as well as moved rows.
+     * Empty if both plans have the same content.
+     */
+    static TArray<FString> Compare(const FBuildPlanView& Old, const FBuildPlanView& New);
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlanTypes.h"
+
+class FArchive;
+
+/**
+ * Streams rows from a plan file, so that big factories do not have to go through the chat.
+ * Supports the chat command syntax (groups separated by commas or new lines, '#' starts a comment line) and JSON
+ * exports: either an array of rows or an object with "rows" and optional "beltTier" / "power" / "floor" fields,
+ * where a row is {"count": 2, "machine": "Smelter", "recipe": "IngotIron", "clock": 75, "rate": 90, "sloops": 1}.
+ * The beltTier, power and floor options must come before the first row.
+ */
+class FPlanFileReader
+{
+  public:
+    // Called for every row as soon as it has been read, with the command-level options read so far applied.
+    // Return false (and set OutError) to stop reading.
+    using FOnRow = TFunctionRef<bool(const FFactoryCommandToken& Row, FString& OutError)>;
+
+    // Looks up <Name> (optionally without .txt/.json) in Saved/FactorySpawner and Config/FactorySpawner
+    static FString FindPlanFile(const FString& Name);
+
+    static bool ReadFile(const FString& Path, FOnRow OnRow, FString& OutError);
+
+  private:
+    static bool ReadCommandStream(FArchive& Reader, FOnRow OnRow, FString& OutError);
+    static bool ReadJsonStream(FArchive& Reader, FOnRow OnRow, FString& OutError);
+};
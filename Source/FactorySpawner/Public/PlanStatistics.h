@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BuildPlan.h"
+
+class UBuildableCache;
+class UFGItemDescriptor;
+
+// Belts, lifts, pipes or power lines of one tier
+struct FSplineTotals
+{
+    int32 Count = 0;
+    float Length = 0.0f; // m, the height for lifts
+    int32 CostUnits = 0; // How often the build recipe is charged
+};
+
+/**
+ * Bill of materials and layout figures of a plan, without spawning anything.
+ * Lengths are measured between the buildables, so they are a close estimate of what the build gun will charge.
+ */
+struct FPlanStatistics
+{
+    TMap<EBuildable, int32> Buildables;   // Machines, splitters, mergers, poles and crosses
+    TMap<FString, int32> CustomMachines; // By class path, counted as CustomMachine in Buildables as well
+    FSplineTotals Belts[6];
+    FSplineTotals Lifts[6];
+    FSplineTotals Pipes[2];
+    FSplineTotals PowerLines;
+
+    FBox Bounds = FBox(ForceInit); // cm, including machine footprints
+    float PowerDraw = 0.0f;        // MW
+    float PowerOutput = 0.0f;      // MW
+
+    TMap<TSubclassOf<UFGItemDescriptor>, int32> BuildCost;
+    TArray<FString> MissingBuildRecipes; // Buildables without an unlocked build recipe
+
+    // Machine footprints come from the cache's layouts
+    static FPlanStatistics Compute(const FBuildPlanView& Plan, UBuildableCache* Cache);
+
+    // Adds up the build recipes of all buildables
+    void ComputeBuildCost(UBuildableCache* Cache, UWorld* World);
+
+    // Chat lines
+    TArray<FString> GetReport() const;
+};
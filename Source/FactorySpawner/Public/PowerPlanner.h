@@ -0,0 +1,51 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/MemStack.h"
+
+// A machine that needs power: the spot next to it where a pole may stand, and the group (row) it belongs to
+struct FPowerSite
+{
+    FVector Anchor = FVector::ZeroVector;
+    int32 Group = 0;
+    bool bWallMount = false; // Served by a (Mk1) wall outlet instead of a pole
+};
+
+struct FPlannedPole
+{
+    FVector Location = FVector::ZeroVector;
+    int32 Tier = 1;
+    bool bWallMount = false;
+    TArray<int32, TInlineAllocator<8>> Sites; // A Mk3 pole serves at most 7 sites
+};
+
+struct FPowerNetworkPlan
+{
+    TArray<FPlannedPole> Poles;
+    TArray<TPair<int32, int32>> PoleLinks; // Spanning tree between poles (indices into Poles)
+};
+
+/**
+ * Plans a minimal power network: poles are shared by as many neighbouring machines as the pole tier and the
+ * power line reach allow, the poles of a row are chained along it and the rows are joined at their head poles
+ * with a degree-limited minimum spanning tree. Each pole keeps slots only for the links it gets and then takes
+ * the lowest tier that has enough connection slots for its wires.
+ */
+class FPowerPlanner
+{
+  public:
+    // Number of power line connections of a power pole Mk1 - Mk3
+    static int32 GetPoleConnections(int32 Tier);
+
+    // Group used for sites that may share a pole with sites of any row
+    static constexpr int32 SharedGroup = INDEX_NONE;
+
+    // Scratch arrays live on the thread's FMemStack and are released before returning
+    static FPowerNetworkPlan Plan(TConstArrayView<FPowerSite> Sites, int32 MaxTier);
+
+  private:
+    // OutGroupStarts gets the index of the first (head) pole of every group; the poles of a group are contiguous
+    static void PlacePoles(TConstArrayView<FPowerSite> Sites, int32 MaxTier, FPowerNetworkPlan& Plan,
+                           TArray<int32, TMemStackAllocator<>>& OutGroupStarts);
+    static void ConnectPoles(int32 MaxConnections, TConstArrayView<int32> GroupStarts, FPowerNetworkPlan& Plan);
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Recipe names resolved in earlier sessions, kept in Saved/FactorySpawner/RecipeIndex.json.
+ * The file belongs to one game build and set of installed mods; it is ignored as soon as either changes.
+ * Entries map "<machine class>/<recipe name as typed>" to the recipe class path.
+ */
+class FRecipeIndex
+{
+  public:
+    static constexpr int32 Version = 1;
+
+    // Empty if the file is missing, unreadable or written by another game build or mod set
+    static TMap<FString, FString> Load();
+
+    static void Save(const TMap<FString, FString>& Recipes);
+
+    static FString GetPath();
+
+  private:
+    // Game build plus the name and version of every enabled plugin
+    static FString GetEnvironmentKey();
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// One ingredient or product of the row's recipe, each with a manifold of its own
+struct FSimulatedItem
+{
+    float PerCycle = 0.0f;   // Items (or m³) per cycle, before production boost
+    float StackSize = 100.0f; // Capacity of the machine's input or output slot
+    bool bFluid = false;
+    float BeltShare = 1.0f;   // Share of a mixed belt's throughput and room, 1 for a manifold of its own
+};
+
+/**
+ * A production row as the generator lays it out: every ingredient is fed into the head of a splitter (or cross)
+ * manifold, every product leaves through a merger manifold towards the head of the row.
+ */
+struct FRowSimulationInput
+{
+    int32 Machines = 0;
+    TArray<float> CycleSeconds;    // Per machine, at its clock
+    TArray<float> ProductionBoost; // Per machine, 1 without somersloops
+
+    TArray<FSimulatedItem> Ingredients;
+    TArray<FSimulatedItem> Products; // Main product first
+
+    float MachineSpacing = 0.0f; // m, belt between neighbouring splitters or mergers
+    float BeltRate = 0.0f;       // Items per minute
+    float PipeRate = 0.0f;       // m³ per minute
+
+    // Supply at the head of each ingredient manifold per minute; empty means what the row needs, capped by the belt
+    TArray<float> FeedRates;
+};
+
+struct FRowSimulationResult
+{
+    float PlannedOutput = 0.0f; // Main product per minute if every machine runs all the time
+    float SteadyOutput = 0.0f;  // Main product per minute leaving the row at the end of the simulation
+    float SecondsToSteadyState = -1.0f; // Game time until every machine runs, negative if that never happens
+
+    int32 StarvedMachines = 0; // Waiting for ingredients at the end
+    int32 BlockedMachines = 0; // Waiting for room in the output manifold
+    int32 FirstStarvedMachine = INDEX_NONE;
+    TArray<float> Utilization; // Per machine over the last simulated minute (0 - 1)
+
+    float SimulatedSeconds = 0.0f;
+    double CpuMilliseconds = 0.0;
+};
+
+/**
+ * Predicts how a generated row fills up, without a world. Items move in fixed time steps: belt and pipe segments
+ * are queues of one item per meter, splitters and mergers share evenly between their outputs or inputs and
+ * machines run whole cycles once every ingredient is there and every product fits.
+ */
+class FRowSimulator
+{
+  public:
+    static constexpr float TimeStep = 0.5f;         // s
+    static constexpr float MaxSimulatedSeconds = 3600.0f;
+
+    static FRowSimulationResult Simulate(const FRowSimulationInput& Input);
+
+    // "312.5 of 360.0/min, 3 machines starve (first: #14)" for the row summary
+    static FString GetSummary(const FRowSimulationResult& Result);
+};